@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <vector>
 #include <string>
 #include <cstdlib>
@@ -14,6 +15,28 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <signal.h>
+#include <cerrno>
+#include <elf.h>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 
 // ===================================================================
@@ -22,241 +45,3902 @@
 struct App {
     std::string name;
     std::string icon_path; // Path to the icon file (e.g., "kodi.png")
+    std::vector<std::string> env; // "KEY=VALUE" overrides for all variants
     struct Variant {
         std::string command;
         std::string variant_name;
+        std::vector<std::string> argv; // Pre-split command, when not using the shell
+        bool use_shell = false;
+        std::vector<std::string> env; // "KEY=VALUE" overrides for this variant
     };
     std::vector<Variant> variants;
 };
 
 
+// ===================================================================
+// App Launching
+// ===================================================================
+// Commands are split into argv once, when apps.conf is parsed, and started
+// directly with posix_spawnp; no /bin/sh in between. A command prefixed
+// with "sh:" is run through the shell instead, as is (for compatibility)
+// any command that uses shell syntax such as pipes, redirects, `&&`,
+// variables or globs.
+static const char* SHELL_PREFIX = "sh:";
+
+// Split like a shell would for plain words with '...', "..." and \ quoting.
+// Returns false when the command needs an actual shell.
+static bool split_command(const std::string &cmd, std::vector<std::string> &argv) {
+    argv.clear();
+    std::string word;
+    bool in_word = false;
+    char quote = 0;
+    for (size_t i = 0; i < cmd.size(); ++i) {
+        char c = cmd[i];
+        if (quote == '\'') {
+            if (c == '\'') {
+                quote = 0;
+            } else {
+                word += c;
+            }
+        } else if (quote == '"') {
+            if (c == '"') {
+                quote = 0;
+            } else if (c == '\\' && i + 1 < cmd.size() && std::strchr("\\\"$`", cmd[i + 1])) {
+                word += cmd[++i];
+            } else if (c == '$' || c == '`') {
+                return false;
+            } else {
+                word += c;
+            }
+        } else if (c == ' ' || c == '\t') {
+            if (in_word) {
+                argv.push_back(word);
+                word.clear();
+                in_word = false;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            in_word = true;
+        } else if (c == '\\' && i + 1 < cmd.size()) {
+            word += cmd[++i];
+            in_word = true;
+        } else if (std::strchr("|&;<>()$`*?[#", c) || (c == '~' && !in_word)) {
+            return false;
+        } else if (c == '=' && argv.empty() && word.find('=') == std::string::npos) {
+            return false; // Leading VAR=value assignment.
+        } else {
+            word += c;
+            in_word = true;
+        }
+    }
+    if (quote) {
+        return false;
+    }
+    if (in_word) {
+        argv.push_back(word);
+    }
+    return !argv.empty();
+}
+
+static void prepare_command(App::Variant &v) {
+    if (v.command.compare(0, std::strlen(SHELL_PREFIX), SHELL_PREFIX) == 0) {
+        v.use_shell = true;
+        v.argv = {"/bin/sh", "-c", v.command.substr(std::strlen(SHELL_PREFIX))};
+    } else if (!split_command(v.command, v.argv)) {
+        v.use_shell = true;
+        v.argv = {"/bin/sh", "-c", v.command};
+    }
+}
+
+struct LaunchResult {
+    bool started = false;
+    int exit_status = -1; // Exit code, or -1 when it did not exit normally.
+    int signal = 0;       // Terminating signal, if any.
+    double wall_s = 0.0;
+};
+
+// Start the variant and wait for it to finish.
+static LaunchResult launch_variant(const App &app, const App::Variant &v) {
+    LaunchResult result;
+
+    // Environment: ours (including env.conf) with the app's and then the
+    // variant's overrides applied on top.
+    std::vector<std::string> env_storage;
+    for (char** e = environ; *e; ++e) {
+        env_storage.push_back(*e);
+    }
+    for (const auto* overrides : {&app.env, &v.env}) {
+        for (const std::string &kv : *overrides) {
+            std::string key = kv.substr(0, kv.find('=') + 1);
+            auto it = std::find_if(env_storage.begin(), env_storage.end(), [&key](const std::string &e) {
+                return e.compare(0, key.size(), key) == 0;
+            });
+            if (it != env_storage.end()) {
+                *it = kv;
+            } else {
+                env_storage.push_back(kv);
+            }
+        }
+    }
+    std::vector<char*> envp;
+    for (auto &e : env_storage) {
+        envp.push_back(e.data());
+    }
+    envp.push_back(nullptr);
+
+    std::vector<std::string> argv_storage = v.argv;
+    std::vector<char*> argv;
+    for (auto &a : argv_storage) {
+        argv.push_back(a.data());
+    }
+    argv.push_back(nullptr);
+
+    // The child starts with default signal handling and an empty mask.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigset_t defaults;
+    sigfillset(&defaults);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], nullptr, &attr, argv.data(), envp.data());
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+        std::cerr << "Error: Could not start '" << argv_storage[0] << "': " << std::strerror(err) << std::endl;
+        return result;
+    }
+    result.started = true;
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    result.wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (WIFEXITED(status)) {
+        result.exit_status = WEXITSTATUS(status);
+        std::cout << "Launcher: '" << app.name << "' exited with status " << result.exit_status;
+    } else if (WIFSIGNALED(status)) {
+        result.signal = WTERMSIG(status);
+        std::cout << "Launcher: '" << app.name << "' was killed by signal " << result.signal;
+    }
+    std::cout << " after " << result.wall_s << " s" << std::endl;
+    return result;
+}
+
+// ===================================================================
+// Launch History
+// ===================================================================
+// Every launch is appended to launches.log as one fixed-size record, in a
+// single write. `launcher --report` prints per-app aggregates from it, and
+// with --order=history the menu puts the most launched apps first, each on
+// the variant it was last started with. Once the log holds
+// LAUNCH_LOG_MAX_RECORDS it is moved to launches.log.1 and a new one started.
+static const char* LAUNCH_LOG_PATH = "launches.log";
+static const char* LAUNCH_LOG_OLD_PATH = "launches.log.1";
+static const size_t LAUNCH_LOG_MAX_RECORDS = 32768; // 4 MiB
+
+struct LaunchRecord {
+    char app[64];         // NUL-padded, truncated if longer
+    char variant[32];
+    Sint64 start_unix_ms;
+    Uint32 run_ms;        // Start to exit
+    Uint32 menu_ms;       // Exit to the menu being back on screen; 0: unknown
+    Sint32 exit_status;   // -1 when it did not exit normally
+    Sint32 signal;
+    Uint32 started;       // 0 when it could not be started at all
+    Uint32 reserved;
+};
+static_assert(sizeof(LaunchRecord) == 128, "launches.log record size");
+
+class LaunchHistory {
+public:
+    struct Stats {
+        Uint32 launches = 0;
+        Uint32 failed = 0;    // Not started, or non-zero exit status
+        Uint32 crashed = 0;   // Killed by a signal
+        Uint64 run_ms = 0;    // Total
+        Uint64 menu_ms = 0;   // Total over menu_samples
+        Uint32 menu_samples = 0;
+        Uint32 menu_ms_max = 0;
+        Sint64 last_start_unix_ms = 0;
+        std::string last_variant;
+    };
+
+    // Read both logs in one read each.
+    void load() {
+        stats_.clear();
+        for (const char* path : {LAUNCH_LOG_OLD_PATH, LAUNCH_LOG_PATH}) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                continue;
+            }
+            std::vector<LaunchRecord> records(size_t(file.tellg()) / sizeof(LaunchRecord));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(LaunchRecord));
+            for (const auto &rec : records) {
+                add(rec);
+            }
+        }
+    }
+
+    static LaunchRecord make_record(const App &app, const App::Variant &variant, Sint64 start_unix_ms,
+                                    const LaunchResult &result) {
+        LaunchRecord rec = {};
+        std::strncpy(rec.app, app.name.c_str(), sizeof(rec.app) - 1);
+        std::strncpy(rec.variant, variant.variant_name.c_str(), sizeof(rec.variant) - 1);
+        rec.start_unix_ms = start_unix_ms;
+        rec.run_ms = Uint32(result.wall_s * 1000.0);
+        rec.exit_status = result.exit_status;
+        rec.signal = result.signal;
+        rec.started = result.started;
+        return rec;
+    }
+
+    // Returns the offset of the record in the log, or -1.
+    Sint64 append(const LaunchRecord &rec) {
+        add(rec);
+        struct stat st;
+        if (stat(LAUNCH_LOG_PATH, &st) == 0 && size_t(st.st_size) >= LAUNCH_LOG_MAX_RECORDS * sizeof(LaunchRecord)) {
+            std::rename(LAUNCH_LOG_PATH, LAUNCH_LOG_OLD_PATH);
+        }
+        Sint64 offset = -1;
+        int fd = open(LAUNCH_LOG_PATH, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0 && write(fd, &rec, sizeof(rec)) == ssize_t(sizeof(rec))) {
+            offset = Sint64(lseek(fd, 0, SEEK_CUR)) - Sint64(sizeof(rec));
+        } else {
+            std::cerr << "Warning: Could not write " << LAUNCH_LOG_PATH << ": " << std::strerror(errno) << std::endl;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return offset;
+    }
+
+    // Fill in menu_ms of the record at offset once the menu is back; the
+    // record itself is written as soon as the app exits, in case the menu
+    // never comes back.
+    void set_menu_ms(Sint64 offset, const LaunchRecord &rec, Uint32 menu_ms) {
+        Stats &s = stats_[std::string(rec.app, strnlen(rec.app, sizeof(rec.app)))];
+        s.menu_ms += menu_ms;
+        s.menu_samples++;
+        s.menu_ms_max = std::max(s.menu_ms_max, menu_ms);
+        int fd = offset >= 0 ? open(LAUNCH_LOG_PATH, O_WRONLY | O_CLOEXEC) : -1;
+        if (fd >= 0) {
+            (void)!pwrite(fd, &menu_ms, sizeof(menu_ms), offset + offsetof(LaunchRecord, menu_ms));
+            ::close(fd);
+        }
+    }
+
+    // Most launched first, then most recently launched; apps without
+    // history keep their order after those.
+    void order(std::vector<App> &apps) const {
+        std::stable_sort(apps.begin(), apps.end(), [this](const App &a, const App &b) {
+            const Stats* sa = find(a.name);
+            const Stats* sb = find(b.name);
+            if (!sa || !sb) {
+                return sa && !sb;
+            }
+            if (sa->launches != sb->launches) {
+                return sa->launches > sb->launches;
+            }
+            return sa->last_start_unix_ms > sb->last_start_unix_ms;
+        });
+    }
+
+    // The variant the app was last launched with, or 0.
+    int last_variant(const App &app) const {
+        const Stats* stats = find(app.name);
+        for (size_t i = 0; stats && i < app.variants.size(); ++i) {
+            if (key(app.variants[i].variant_name, sizeof(LaunchRecord::variant)) == stats->last_variant) {
+                return int(i);
+            }
+        }
+        return 0;
+    }
+
+    int report(std::ostream &out) const {
+        if (stats_.empty()) {
+            out << "No launches recorded in " << LAUNCH_LOG_PATH << std::endl;
+            return 1;
+        }
+        std::vector<std::pair<std::string, const Stats*>> rows;
+        for (const auto &entry : stats_) {
+            rows.emplace_back(entry.first, &entry.second);
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+            return a.second->launches > b.second->launches;
+        });
+        out << std::left << std::setw(32) << "app" << std::right
+            << std::setw(9) << "launches" << std::setw(8) << "failed" << std::setw(9) << "crashed"
+            << std::setw(12) << "avg run s" << std::setw(13) << "avg menu ms" << std::setw(13) << "max menu ms"
+            << "  last launch" << std::endl;
+        for (const auto &row : rows) {
+            const Stats &s = *row.second;
+            char last[32] = "";
+            time_t t = time_t(s.last_start_unix_ms / 1000);
+            struct tm tm;
+            if (localtime_r(&t, &tm)) {
+                std::strftime(last, sizeof(last), "%Y-%m-%d %H:%M", &tm);
+            }
+            out << std::left << std::setw(32) << row.first.substr(0, 31) << std::right
+                << std::setw(9) << s.launches << std::setw(8) << s.failed << std::setw(9) << s.crashed
+                << std::setw(12) << std::fixed << std::setprecision(1) << s.run_ms / 1000.0 / s.launches
+                << std::setw(13) << std::setprecision(0) << (s.menu_samples ? double(s.menu_ms) / s.menu_samples : 0.0)
+                << std::setw(13) << s.menu_ms_max << "  " << last << std::endl;
+        }
+        return 0;
+    }
+
+private:
+    // Names as stored in a record of that field size.
+    static std::string key(const std::string &name, size_t field_size) {
+        return name.substr(0, field_size - 1);
+    }
+
+    const Stats* find(const std::string &name) const {
+        auto it = stats_.find(key(name, sizeof(LaunchRecord::app)));
+        return it == stats_.end() ? nullptr : &it->second;
+    }
+
+    void add(const LaunchRecord &rec) {
+        Stats &s = stats_[std::string(rec.app, strnlen(rec.app, sizeof(rec.app)))];
+        s.launches++;
+        if (!rec.started || rec.exit_status > 0) {
+            s.failed++;
+        }
+        if (rec.signal) {
+            s.crashed++;
+        }
+        s.run_ms += rec.run_ms;
+        if (rec.menu_ms) {
+            s.menu_ms += rec.menu_ms;
+            s.menu_samples++;
+            s.menu_ms_max = std::max(s.menu_ms_max, rec.menu_ms);
+        }
+        if (rec.start_unix_ms >= s.last_start_unix_ms) {
+            s.last_start_unix_ms = rec.start_unix_ms;
+            s.last_variant = std::string(rec.variant, strnlen(rec.variant, sizeof(rec.variant)));
+        }
+    }
+
+    std::map<std::string, Stats> stats_;
+};
+
+
+
+// ===================================================================
+// Prefetcher
+// ===================================================================
+// Once the selection has rested on a variant for a moment, a background
+// thread resolves the executable(s) of its command through PATH, follows
+// their DT_NEEDED libraries and reads them into the page cache, so a cold
+// start from the SD card does not have to wait on flash once confirmed.
+// Moving the selection cancels the current run between chunks.
+class Prefetcher {
+public:
+    bool enabled = true;
+    Uint32 dwell_ms = 300;
+
+    ~Prefetcher() {
+        stop();
+    }
+
+    // Hover over a variant (nullptr: nothing / cancel). Render thread only.
+    void hover(const App::Variant* v) {
+        if (!enabled) {
+            return;
+        }
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&Prefetcher::run, this);
+        }
+        // env.conf can change these while the thread runs; it gets a copy.
+        const char* path_env = std::getenv("PATH");
+        const char* ld_env = std::getenv("LD_LIBRARY_PATH");
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+        target_ = v ? v->argv : std::vector<std::string>();
+        label_ = v ? v->command : std::string();
+        env_.path = path_env ? path_env : "/usr/local/bin:/usr/bin:/bin";
+        env_.ld_library_path = ld_env ? ld_env : "";
+        deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(dwell_ms);
+        cv_.notify_one();
+    }
+
+    // The hovered variant is being launched: start on it without waiting
+    // out the dwell. One already under way just carries on.
+    void hurry() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deadline_ = std::chrono::steady_clock::now();
+        cv_.notify_one();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            generation_++;
+        }
+        cv_.notify_one();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        stopping_ = false;
+    }
+
+private:
+    struct Totals {
+        int files = 0;
+        Uint64 bytes = 0;
+        Uint64 resident = 0; // Already in the page cache before we started.
+    };
+
+    // What the launch would search, as of the last hover.
+    struct Env {
+        std::string path;
+        std::string ld_library_path;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (target_.empty()) {
+                cv_.wait(lock);
+                continue;
+            }
+            Uint64 gen = generation_;
+            if (cv_.wait_until(lock, deadline_, [&] { return stopping_ || generation_ != gen; })) {
+                continue; // Selection moved on before the dwell expired.
+            }
+            std::vector<std::string> argv = std::move(target_);
+            std::string label = label_;
+            Env env = env_;
+            target_.clear();
+            lock.unlock();
+            prefetch(argv, env, label, gen);
+            lock.lock();
+        }
+    }
+
+    bool cancelled(Uint64 gen) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stopping_ || generation_ != gen;
+    }
+
+    void prefetch(const std::vector<std::string> &argv, const Env &env, const std::string &label, Uint64 gen) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> key = argv;
+        key.push_back(env.path);
+        key.push_back(env.ld_library_path);
+        std::vector<std::string> &files = resolved_[argv_key(key)];
+        if (files.empty()) {
+            files = resolve_files(argv, env);
+        }
+
+        Totals totals;
+        bool complete = true;
+        for (const std::string &path : files) {
+            if (!prefetch_file(path, gen, totals)) {
+                complete = false;
+                break;
+            }
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Prefetch '" << label << "': " << totals.files << " files, "
+                  << totals.bytes / 1024 << " KiB, " << totals.resident / 1024 << " KiB already resident, "
+                  << ms << " ms" << (complete ? "" : " (cancelled)") << std::endl;
+    }
+
+    static std::string argv_key(const std::vector<std::string> &argv) {
+        std::string key;
+        for (const auto &a : argv) {
+            key += a;
+            key += '\0';
+        }
+        return key;
+    }
+
+    // Read one file into the page cache in chunks, checking for cancellation.
+    bool prefetch_file(const std::string &path, Uint64 gen, Totals &totals) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return true;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return true;
+        }
+        const size_t size = st.st_size;
+        const size_t page = sysconf(_SC_PAGESIZE);
+        void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            std::vector<unsigned char> vec((size + page - 1) / page);
+            if (mincore(map, size, vec.data()) == 0) {
+                for (size_t i = 0; i < vec.size(); ++i) {
+                    totals.resident += (vec[i] & 1) ? std::min(page, size - i * page) : 0;
+                }
+            }
+            munmap(map, size);
+        }
+        totals.files++;
+        totals.bytes += size;
+
+        const size_t CHUNK = 1 << 20;
+        bool complete = true;
+        for (size_t off = 0; off < size; off += CHUNK) {
+            if (cancelled(gen)) {
+                complete = false;
+                break;
+            }
+            readahead(fd, off, std::min(CHUNK, size - off));
+        }
+        ::close(fd);
+        return complete;
+    }
+
+    static std::string find_in_path(const std::string &name, const std::string &paths) {
+        if (name.find('/') != std::string::npos) {
+            return name;
+        }
+        size_t pos = 0;
+        while (pos <= paths.size()) {
+            size_t end = paths.find(':', pos);
+            if (end == std::string::npos) {
+                end = paths.size();
+            }
+            std::string candidate = paths.substr(pos, end - pos) + "/" + name;
+            if (access(candidate.c_str(), X_OK) == 0) {
+                return candidate;
+            }
+            pos = end + 1;
+        }
+        return "";
+    }
+
+    // The executable, any absolute/relative program paths among its
+    // arguments (wrappers like sudo or meson devenv) and all their
+    // libraries, transitively.
+    std::vector<std::string> resolve_files(const std::vector<std::string> &argv, const Env &env) {
+        std::vector<std::string> roots;
+        std::vector<std::string> words = argv;
+        if (argv.size() == 3 && argv[0] == "/bin/sh" && argv[1] == "-c") {
+            split_words(argv[2], words);
+        }
+        for (size_t i = 0; i < words.size(); ++i) {
+            std::string path = i == 0 ? find_in_path(words[i], env.path) : words[i];
+            struct stat st;
+            if (!path.empty() && path.find('/') != std::string::npos && stat(path.c_str(), &st) == 0
+                && S_ISREG(st.st_mode) && (st.st_mode & S_IXUSR)) {
+                roots.push_back(path);
+            }
+        }
+
+        std::vector<std::string> ld_dirs;
+        if (!env.ld_library_path.empty()) {
+            const std::string &paths = env.ld_library_path;
+            size_t pos = 0;
+            while (pos <= paths.size()) {
+                size_t end = std::min(paths.find(':', pos), paths.size());
+                ld_dirs.push_back(paths.substr(pos, end - pos));
+                pos = end + 1;
+            }
+        }
+
+        std::vector<std::string> files;
+        std::vector<std::string> queue = roots;
+        std::vector<std::string> seen;
+        while (!queue.empty()) {
+            std::string path = queue.back();
+            queue.pop_back();
+            if (std::find(seen.begin(), seen.end(), path) != seen.end()) {
+                continue;
+            }
+            seen.push_back(path);
+            files.push_back(path);
+            std::vector<std::string> needed, search;
+            read_elf_dynamic(path, needed, search);
+            for (const auto &lib : needed) {
+                std::string resolved = find_library(lib, search, ld_dirs);
+                if (!resolved.empty()) {
+                    queue.push_back(resolved);
+                }
+            }
+        }
+        return files;
+    }
+
+    static void split_words(const std::string &str, std::vector<std::string> &words) {
+        words.clear();
+        std::string word;
+        for (char c : str + " ") {
+            if (std::strchr(" \t;&|()<>", c)) {
+                if (!word.empty()) {
+                    words.push_back(word);
+                }
+                word.clear();
+            } else {
+                word += c;
+            }
+        }
+    }
+
+    // Collect DT_NEEDED entries and the RPATH/RUNPATH directories of an ELF
+    // file (native byte order, 32 or 64 bit).
+    template <typename Ehdr, typename Phdr, typename Dyn>
+    static void read_elf_dynamic_impl(const char* data, size_t size, const std::string &origin,
+                                      std::vector<std::string> &needed, std::vector<std::string> &search) {
+        const Ehdr* eh = reinterpret_cast<const Ehdr*>(data);
+        if (eh->e_phoff + Uint64(eh->e_phnum) * sizeof(Phdr) > size) {
+            return;
+        }
+        const Phdr* ph = reinterpret_cast<const Phdr*>(data + eh->e_phoff);
+        const Phdr* dynamic = nullptr;
+        for (int i = 0; i < eh->e_phnum; ++i) {
+            if (ph[i].p_type == PT_DYNAMIC) {
+                dynamic = &ph[i];
+            } else if (ph[i].p_type == PT_INTERP && ph[i].p_offset + ph[i].p_filesz <= size) {
+                // The dynamic loader itself, e.g. /lib/ld-linux-aarch64.so.1
+                const char* interp = data + ph[i].p_offset;
+                needed.push_back(std::string(interp, strnlen(interp, ph[i].p_filesz)));
+            }
+        }
+        if (!dynamic || dynamic->p_offset + dynamic->p_filesz > size) {
+            return;
+        }
+        auto vaddr_to_offset = [&](Uint64 vaddr) -> Uint64 {
+            for (int i = 0; i < eh->e_phnum; ++i) {
+                if (ph[i].p_type == PT_LOAD && vaddr >= ph[i].p_vaddr && vaddr < ph[i].p_vaddr + ph[i].p_filesz) {
+                    return vaddr - ph[i].p_vaddr + ph[i].p_offset;
+                }
+            }
+            return size;
+        };
+
+        const Dyn* dyn = reinterpret_cast<const Dyn*>(data + dynamic->p_offset);
+        size_t count = dynamic->p_filesz / sizeof(Dyn);
+        Uint64 strtab = size;
+        for (size_t i = 0; i < count && dyn[i].d_tag != DT_NULL; ++i) {
+            if (dyn[i].d_tag == DT_STRTAB) {
+                strtab = vaddr_to_offset(dyn[i].d_un.d_ptr);
+            }
+        }
+        if (strtab >= size) {
+            return;
+        }
+        auto str = [&](Uint64 off) {
+            Uint64 pos = strtab + off;
+            return pos < size ? std::string(data + pos, strnlen(data + pos, size - pos)) : std::string();
+        };
+        for (size_t i = 0; i < count && dyn[i].d_tag != DT_NULL; ++i) {
+            if (dyn[i].d_tag == DT_NEEDED) {
+                needed.push_back(str(dyn[i].d_un.d_val));
+            } else if (dyn[i].d_tag == DT_RPATH || dyn[i].d_tag == DT_RUNPATH) {
+                std::string paths = str(dyn[i].d_un.d_val);
+                size_t pos = 0;
+                while (pos <= paths.size()) {
+                    size_t end = std::min(paths.find(':', pos), paths.size());
+                    std::string dir = paths.substr(pos, end - pos);
+                    size_t o = dir.find("$ORIGIN");
+                    if (o != std::string::npos) {
+                        dir.replace(o, 7, origin);
+                    }
+                    search.push_back(dir);
+                    pos = end + 1;
+                }
+            }
+        }
+    }
+
+    static void read_elf_dynamic(const std::string &path, std::vector<std::string> &needed,
+                                 std::vector<std::string> &search) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        void* map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Elf64_Ehdr)) {
+            map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            return;
+        }
+        const char* data = static_cast<const char*>(map);
+        std::string origin = std::filesystem::path(path).parent_path().string();
+        if (std::memcmp(data, ELFMAG, SELFMAG) == 0) {
+            if (data[EI_CLASS] == ELFCLASS64) {
+                read_elf_dynamic_impl<Elf64_Ehdr, Elf64_Phdr, Elf64_Dyn>(data, st.st_size, origin, needed, search);
+            } else if (data[EI_CLASS] == ELFCLASS32) {
+                read_elf_dynamic_impl<Elf32_Ehdr, Elf32_Phdr, Elf32_Dyn>(data, st.st_size, origin, needed, search);
+            }
+        }
+        munmap(map, st.st_size);
+    }
+
+    // RPATH/RUNPATH, LD_LIBRARY_PATH, then the usual system directories.
+    static std::string find_library(const std::string &name, const std::vector<std::string> &search,
+                                    const std::vector<std::string> &ld_dirs) {
+        if (name.find('/') != std::string::npos) {
+            return name;
+        }
+        static const std::vector<std::string> system_dirs = [] {
+            std::vector<std::string> dirs;
+            for (const char* triplet : {"aarch64-linux-gnu", "arm-linux-gnueabihf", "x86_64-linux-gnu"}) {
+                dirs.push_back(std::string("/lib/") + triplet);
+                dirs.push_back(std::string("/usr/lib/") + triplet);
+            }
+            for (const char* dir : {"/usr/local/lib", "/lib64", "/usr/lib64", "/lib", "/usr/lib"}) {
+                dirs.push_back(dir);
+            }
+            return dirs;
+        }();
+        for (const auto* dirs : {&search, &ld_dirs, &system_dirs}) {
+            for (const auto &dir : *dirs) {
+                std::string candidate = dir + "/" + name;
+                if (access(candidate.c_str(), R_OK) == 0) {
+                    return candidate;
+                }
+            }
+        }
+        return "";
+    }
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::string> target_;
+    std::string label_;
+    Env env_;
+    std::chrono::steady_clock::time_point deadline_;
+    Uint64 generation_ = 0;
+    bool stopping_ = false;
+    std::map<std::string, std::vector<std::string>> resolved_; // Prefetch thread only.
+};
+
+
+// ===================================================================
+// Startup Profiler
+// ===================================================================
+// With --profile-startup every phase of getting the menu on screen (and of
+// handing the display over to an app and coming back) is recorded with a
+// monotonic high-resolution clock. The spans are written as plain JSON and
+// as a Chrome trace-event file that Perfetto / chrome://tracing can open.
+static std::string json_escape(const std::string &str) {
+    std::string out;
+    out.reserve(str.size());
+    for (char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+class Profiler {
+public:
+    bool enabled = false;
+    std::string output_prefix = "startup-profile";
+    int pass = 0; // Outer loop pass; 0 is the cold start.
+
+    static Uint64 now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Record a span that started at start_ns and ends now.
+    void add(const std::string &name, Uint64 start_ns, const char* category = "startup") {
+        if (!enabled) {
+            return;
+        }
+        Uint64 end_ns = now_ns();
+        std::lock_guard<std::mutex> lock(mutex_);
+        spans_.push_back({name, category, start_ns, end_ns, thread_index(), pass});
+    }
+
+    // Write both the JSON summary and the trace; called after every return
+    // to the menu, since the launcher normally never exits.
+    void write() {
+        if (!enabled) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ofstream json(output_prefix + ".json", std::ios::trunc);
+        json << std::fixed << std::setprecision(3);
+        json << "{\n  \"clock\": \"steady_clock\",\n  \"unit\": \"ms\",\n  \"phases\": [";
+        for (size_t i = 0; i < spans_.size(); ++i) {
+            const Span &sp = spans_[i];
+            json << (i ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(sp.name)
+                 << "\", \"category\": \"" << sp.category
+                 << "\", \"pass\": " << sp.pass
+                 << ", \"thread\": " << sp.tid
+                 << ", \"start\": " << (sp.start_ns - origin_ns_) / 1e6
+                 << ", \"duration\": " << (sp.end_ns - sp.start_ns) / 1e6 << "}";
+        }
+        json << "\n  ]\n}\n";
+
+        std::ofstream trace(output_prefix + ".trace.json", std::ios::trunc);
+        trace << std::fixed << std::setprecision(3);
+        trace << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        for (size_t i = 0; i < spans_.size(); ++i) {
+            const Span &sp = spans_[i];
+            trace << (i ? ",\n" : "\n") << "{\"name\": \"" << json_escape(sp.name)
+                  << "\", \"cat\": \"" << sp.category
+                  << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << sp.tid
+                  << ", \"ts\": " << (sp.start_ns - origin_ns_) / 1e3
+                  << ", \"dur\": " << (sp.end_ns - sp.start_ns) / 1e3
+                  << ", \"args\": {\"pass\": " << sp.pass << "}}";
+        }
+        trace << "\n]}\n";
+        std::cout << "Startup profile written to " << output_prefix << ".json and "
+                  << output_prefix << ".trace.json" << std::endl;
+    }
+
+private:
+    struct Span {
+        std::string name;
+        const char* category;
+        Uint64 start_ns;
+        Uint64 end_ns;
+        int tid;
+        int pass;
+    };
+
+    static int thread_index() {
+        static std::atomic<int> next{0};
+        thread_local int index = next++;
+        return index;
+    }
+
+    std::mutex mutex_;
+    std::vector<Span> spans_;
+    Uint64 origin_ns_ = now_ns(); // Roughly process start.
+};
+
+static Profiler profiler;
+
+// Records the enclosing scope as one span.
+struct ProfileScope {
+    std::string name;
+    Uint64 start_ns;
+    explicit ProfileScope(std::string n) : name(std::move(n)), start_ns(Profiler::now_ns()) {}
+    ~ProfileScope() {
+        profiler.add(name, start_ns);
+    }
+};
+
+
+// ===================================================================
+// Frame Statistics
+// ===================================================================
+// --frame-stats collects per-frame CPU time, time spent in
+// SDL_RenderPresent and input-to-present latency (from the SDL event
+// timestamp to the end of the present that shows its effect), and dumps
+// p50/p95/p99 to the log when leaving the menu. --hud also draws them on
+// screen.
+class RollingStats {
+public:
+    static constexpr size_t WINDOW = 1024; // Most recent samples kept.
+
+    void add(double ms) {
+        if (samples_.size() < WINDOW) {
+            samples_.push_back(ms);
+        } else {
+            samples_[next_] = ms;
+        }
+        next_ = (next_ + 1) % WINDOW;
+        total_++;
+        last_ = ms;
+        sum_ += ms;
+    }
+
+    double percentile(double p) const {
+        if (samples_.empty()) {
+            return 0.0;
+        }
+        std::vector<double> sorted = samples_;
+        size_t k = std::min(sorted.size() - 1, size_t(p / 100.0 * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+
+    Uint64 total() const { return total_; }
+    double last() const { return last_; }
+    double mean() const { return total_ ? sum_ / total_ : 0.0; } // Over all samples.
+
+    void reset() {
+        samples_.clear();
+        next_ = 0;
+        total_ = 0;
+        last_ = 0.0;
+        sum_ = 0.0;
+    }
+
+private:
+    std::vector<double> samples_;
+    size_t next_ = 0;
+    Uint64 total_ = 0;
+    double last_ = 0.0;
+    double sum_ = 0.0;
+};
+
+struct FrameStats {
+    bool enabled = false;
+    bool hud = false;
+    RollingStats cpu_ms;
+    RollingStats present_ms;
+    RollingStats input_latency_ms;
+
+    void dump(std::ostream &out) const {
+        auto line = [&out](const char* name, const RollingStats &rs) {
+            out << "  " << name << ": n=" << rs.total()
+                << " p50=" << rs.percentile(50) << " p95=" << rs.percentile(95)
+                << " p99=" << rs.percentile(99) << " ms" << std::endl;
+        };
+        out << std::fixed << std::setprecision(2) << "Frame statistics:" << std::endl;
+        line("frame cpu", cpu_ms);
+        line("present", present_ms);
+        line("input->present", input_latency_ms);
+        out << std::defaultfloat;
+    }
+
+    // Draw the numbers in the top-left corner. The text object is reused
+    // every frame, so this only lays out glyphs from the shared cache.
+    void draw_hud(SDL_Renderer* renderer, TTF_Text* text) const {
+        if (!text) {
+            return;
+        }
+        char str[320];
+        std::snprintf(str, sizeof(str),
+                      "cpu %.2f ms  p95 %.2f  p99 %.2f\n"
+                      "present %.2f ms  p95 %.2f  p99 %.2f\n"
+                      "input %.2f ms  p95 %.2f  p99 %.2f",
+                      cpu_ms.last(), cpu_ms.percentile(95), cpu_ms.percentile(99),
+                      present_ms.last(), present_ms.percentile(95), present_ms.percentile(99),
+                      input_latency_ms.last(), input_latency_ms.percentile(95), input_latency_ms.percentile(99));
+        TTF_SetTextString(text, str, 0);
+
+        int w = 0, h = 0;
+        TTF_GetTextSize(text, &w, &h);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+        SDL_FRect box = {4, 4, w + 8.0f, h + 8.0f};
+        SDL_RenderFillRect(renderer, &box);
+        TTF_SetTextColor(text, 255, 255, 0, 255);
+        TTF_DrawRendererText(text, 8, 8);
+    }
+};
+
+static FrameStats frame_stats;
+
+
+// ===================================================================
+// Input Repeat
+// ===================================================================
+// Navigation repeats while held: a key, a d-pad or shoulder button, or the
+// left stick pushed past the dead zone. The first press steps right away;
+// after delay_ms the direction repeats every interval_ms, each repeat
+// accel times shorter than the one before, down to min_interval_ms. This
+// runs on its own clock rather than per frame: poll() hands out every step
+// that came due since the last call, and wait_ms() tells the menu how long
+// it may sleep. While anything is held the menu wakes at least every
+// TICK_MS to sample the sticks, so releasing one takes effect within that.
+struct RepeatConfig {
+    bool enabled = true;
+    int delay_ms = 400;
+    int interval_ms = 150;
+    float accel = 0.85f;
+    int min_interval_ms = 30;
+    int deadzone = 10000; // Of 32767
+};
+
+class InputRepeat {
+public:
+    enum Direction { LEFT, RIGHT, UP, DOWN, NUM_DIRECTIONS };
+    static constexpr int TICK_MS = 10;
+    // Sources: key codes as they are, and these for the gamepads.
+    static constexpr Uint32 PAD = 0x80000000u;   // | button
+    static constexpr Uint32 STICK = 0x80010000u;
+
+    struct Steps {
+        int count[NUM_DIRECTIONS] = {};
+        bool repeated = false; // Some are repeats rather than presses.
+        Uint64 first_ns = 0;   // When the earliest was due; 0 if none.
+    };
+
+    explicit InputRepeat(const RepeatConfig &config) : config_(config) {}
+
+    void press(Direction dir, Uint32 source, Uint64 now_ns) {
+        Held &h = held_[dir];
+        if (!h.sources.insert(source).second || h.sources.size() > 1) {
+            return; // Already held (e.g. the system's own key repeat).
+        }
+        h.presses++;
+        h.pressed_ns = h.presses == 1 ? now_ns : h.pressed_ns;
+        h.interval_ms = config_.interval_ms;
+        h.next_ns = now_ns + Uint64(config_.delay_ms) * 1000000;
+    }
+
+    void release(Uint32 source) {
+        for (Held &h : held_) {
+            h.sources.erase(source);
+        }
+    }
+
+    void release_all() {
+        for (Held &h : held_) {
+            h.sources.clear();
+        }
+    }
+
+    // A stick that --replay moves with axis events; it counts as one more
+    // pad, since replayed events don't move any real one.
+    void replay_stick(Uint8 axis, int value) {
+        if (axis == SDL_GAMEPAD_AXIS_LEFTX || axis == SDL_GAMEPAD_AXIS_LEFTY) {
+            replayed_[axis] = value;
+        }
+    }
+
+    // The stick pushed furthest on any pad holds the direction of its
+    // dominant axis. It lets go a bit inside the dead zone, so a stick
+    // resting right on its edge doesn't press over and over.
+    void sample_sticks(const std::vector<SDL_Gamepad*> &pads, Uint64 now_ns) {
+        int x = replayed_[SDL_GAMEPAD_AXIS_LEFTX], y = replayed_[SDL_GAMEPAD_AXIS_LEFTY];
+        for (SDL_Gamepad* pad : pads) {
+            int px = SDL_GetGamepadAxis(pad, SDL_GAMEPAD_AXIS_LEFTX);
+            int py = SDL_GetGamepadAxis(pad, SDL_GAMEPAD_AXIS_LEFTY);
+            if (std::max(std::abs(px), std::abs(py)) > std::max(std::abs(x), std::abs(y))) {
+                x = px;
+                y = py;
+            }
+        }
+        const bool horizontal = std::abs(x) >= std::abs(y);
+        const int value[NUM_DIRECTIONS] = {horizontal ? -x : 0, horizontal ? x : 0, horizontal ? 0 : -y, horizontal ? 0 : y};
+        for (int d = 0; d < NUM_DIRECTIONS; ++d) {
+            const bool held = held_[d].sources.count(STICK);
+            if (!held && value[d] > config_.deadzone) {
+                press(Direction(d), STICK, now_ns);
+            } else if (held && value[d] <= config_.deadzone * 3 / 4) {
+                held_[d].sources.erase(STICK);
+            }
+        }
+    }
+
+    bool held() const {
+        for (const Held &h : held_) {
+            if (!h.sources.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The presses since the last call, and the repeats due by now. A menu
+    // that fell far behind gets a few repeats, not all it missed.
+    Steps poll(Uint64 now_ns) {
+        const int MAX_CATCH_UP = 4;
+        Steps steps;
+        auto due = [&steps](Uint64 ns) {
+            steps.first_ns = steps.first_ns ? std::min(steps.first_ns, ns) : ns;
+        };
+        for (int d = 0; d < NUM_DIRECTIONS; ++d) {
+            Held &h = held_[d];
+            if (h.presses) {
+                steps.count[d] += h.presses;
+                due(h.pressed_ns);
+                h.presses = 0;
+            }
+            if (h.sources.empty() || !config_.enabled) {
+                continue;
+            }
+            int repeats = 0;
+            while (h.next_ns <= now_ns && repeats < MAX_CATCH_UP) {
+                due(h.next_ns);
+                repeats++;
+                h.next_ns += Uint64(h.interval_ms * 1e6);
+                h.interval_ms = std::max<double>(config_.min_interval_ms, h.interval_ms * config_.accel);
+            }
+            if (h.next_ns <= now_ns) {
+                h.next_ns = now_ns + Uint64(h.interval_ms * 1e6);
+            }
+            steps.count[d] += repeats;
+            steps.repeated |= repeats > 0;
+        }
+        return steps;
+    }
+
+    // How long until poll() has something new, at most TICK_MS while
+    // anything is held; -1 when nothing is.
+    int wait_ms(Uint64 now_ns) const {
+        int wait = -1;
+        for (const Held &h : held_) {
+            if (h.sources.empty()) {
+                continue;
+            }
+            int ms = TICK_MS;
+            if (config_.enabled) {
+                ms = h.next_ns > now_ns ? std::min<int>(ms, (h.next_ns - now_ns + 999999) / 1000000) : 0;
+            }
+            wait = wait < 0 ? ms : std::min(wait, ms);
+        }
+        return wait;
+    }
+
+private:
+    struct Held {
+        std::set<Uint32> sources;
+        int presses = 0;      // Not yet polled
+        Uint64 pressed_ns = 0;
+        Uint64 next_ns = 0;   // Next repeat
+        double interval_ms = 0.0;
+    };
+    RepeatConfig config_;
+    Held held_[NUM_DIRECTIONS];
+    int replayed_[2] = {}; // Left stick x and y
+};
+
+
+// ===================================================================
+// Input Recording
+// ===================================================================
+// --record=FILE writes every input event the menu handles to FILE, one per
+// line: "<pass> <ms> <kind> <value>", where pass counts menu sessions
+// (launches in between) and ms is the time since that menu came up.
+// --replay=FILE feeds such a file back in with SDL_PushEvent at the same
+// times, on the offscreen video driver with the software renderer and
+// without launching anything, and reports frame timings at the end. This
+// makes the render loop benchmarkable without a display or a person.
+struct InputEvent {
+    int pass = 0;
+    double ms = 0.0;
+    std::string kind; // key, keyup, wheel, mouse, pad, padup, stickx, sticky, text or quit
+    double value = 0.0; // Typed text is one code point per event.
+    std::string text;   // UTF-8 of a text event, kept for SDL_EVENT_TEXT_INPUT.
+};
+
+class InputRecorder {
+public:
+    bool open(const char* path) {
+        out_.open(path, std::ios::trunc);
+        if (!out_) {
+            std::cerr << "Error: Could not open " << path << " for recording" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool active() const {
+        return out_.is_open();
+    }
+
+    void record(int pass, Uint64 since_ns, const SDL_Event &event) {
+        if (!active()) {
+            return;
+        }
+        const char* kind = nullptr;
+        double value = 0.0;
+        switch (event.type) {
+            case SDL_EVENT_KEY_DOWN:
+                if (event.key.repeat) {
+                    return; // Holding is replayed from key and keyup.
+                }
+                kind = "key";
+                value = event.key.key;
+                break;
+            case SDL_EVENT_KEY_UP: kind = "keyup"; value = event.key.key; break;
+            case SDL_EVENT_MOUSE_WHEEL: kind = "wheel"; value = event.wheel.y; break;
+            case SDL_EVENT_MOUSE_BUTTON_DOWN: kind = "mouse"; value = event.button.button; break;
+            case SDL_EVENT_GAMEPAD_BUTTON_DOWN: kind = "pad"; value = event.gbutton.button; break;
+            case SDL_EVENT_GAMEPAD_BUTTON_UP: kind = "padup"; value = event.gbutton.button; break;
+            case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+                // The left stick navigates (see InputRepeat); which pad
+                // moved it is not kept.
+                if (event.gaxis.axis == SDL_GAMEPAD_AXIS_LEFTX) {
+                    kind = "stickx";
+                } else if (event.gaxis.axis == SDL_GAMEPAD_AXIS_LEFTY) {
+                    kind = "sticky";
+                } else {
+                    return;
+                }
+                value = event.gaxis.value;
+                break;
+            case SDL_EVENT_TEXT_INPUT: {
+                // Code points keep the line format free of whitespace.
+                const char* text = event.text.text;
+                while (Uint32 cp = SDL_StepUTF8(&text, nullptr)) {
+                    write(pass, since_ns, "text", cp);
+                }
+                return;
+            }
+            case SDL_EVENT_QUIT: kind = "quit"; break;
+            default: return;
+        }
+        write(pass, since_ns, kind, value);
+    }
+
+private:
+    void write(int pass, Uint64 since_ns, const char* kind, double value) {
+        out_ << pass << " " << std::fixed << std::setprecision(3) << since_ns / 1e6
+             << std::defaultfloat << std::setprecision(12) << " " << kind << " " << value << std::endl;
+    }
+
+    std::ofstream out_;
+};
+
+class InputReplay {
+public:
+    bool load(const char* path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Error: Could not open " << path << " for replay" << std::endl;
+            return false;
+        }
+        InputEvent ev;
+        while (in >> ev.pass >> ev.ms >> ev.kind >> ev.value) {
+            ev.text.clear();
+            if (ev.kind == "text") {
+                char utf8[5] = {};
+                SDL_UCS4ToUTF8(Uint32(ev.value), utf8);
+                ev.text = utf8;
+            }
+            events_.push_back(ev);
+        }
+        recorded_ = events_.size();
+        // End the menu if the recording does not; as its own event so the
+        // effect of the last input still gets rendered.
+        if (events_.empty() || events_.back().kind != "quit") {
+            ev = InputEvent();
+            ev.pass = events_.empty() ? 0 : events_.back().pass;
+            ev.ms = events_.empty() ? 0.0 : events_.back().ms + 500.0;
+            ev.kind = "quit";
+            events_.push_back(ev);
+        }
+        active_ = true;
+        std::cout << "Replay: " << recorded_ << " events from " << path << std::endl;
+        return true;
+    }
+
+    bool active() const {
+        return active_;
+    }
+
+    // Push the events of this pass that are due. Returns the time until
+    // the next one in ms (-1 if there is none in this pass).
+    int pump(int pass, Uint64 since_ns) {
+        const double now_ms = since_ns / 1e6;
+        while (next_ < events_.size() && events_[next_].pass <= pass) {
+            const InputEvent &ev = events_[next_];
+            if (ev.pass == pass && ev.ms > now_ms) {
+                return int(ev.ms - now_ms) + 1;
+            }
+            push(ev);
+            next_++;
+        }
+        return -1;
+    }
+
+    bool finished() const {
+        return next_ >= recorded_;
+    }
+
+    int report(double total_ms, Uint64 frames) const {
+        std::cout << std::fixed << std::setprecision(2)
+                  << "Replay: " << std::min(next_, recorded_) << "/" << recorded_ << " events, " << frames << " frames in "
+                  << total_ms << " ms" << std::endl
+                  << "Replay: frame cpu mean " << frame_stats.cpu_ms.mean()
+                  << " p50 " << frame_stats.cpu_ms.percentile(50)
+                  << " p95 " << frame_stats.cpu_ms.percentile(95)
+                  << " p99 " << frame_stats.cpu_ms.percentile(99) << " ms, present mean "
+                  << frame_stats.present_ms.mean() << " ms" << std::defaultfloat << std::endl;
+        if (!finished()) {
+            std::cerr << "Error: The menu exited before the replay was complete." << std::endl;
+            return 2;
+        }
+        return 0;
+    }
+
+private:
+    static void push(const InputEvent &ev) {
+        SDL_Event event = {};
+        if (ev.kind == "key" || ev.kind == "keyup") {
+            event.type = ev.kind == "key" ? SDL_EVENT_KEY_DOWN : SDL_EVENT_KEY_UP;
+            event.key.key = SDL_Keycode(ev.value);
+            event.key.down = ev.kind == "key";
+        } else if (ev.kind == "wheel") {
+            event.type = SDL_EVENT_MOUSE_WHEEL;
+            event.wheel.y = float(ev.value);
+        } else if (ev.kind == "mouse") {
+            event.type = SDL_EVENT_MOUSE_BUTTON_DOWN;
+            event.button.button = Uint8(ev.value);
+            event.button.down = true;
+        } else if (ev.kind == "pad" || ev.kind == "padup") {
+            event.type = ev.kind == "pad" ? SDL_EVENT_GAMEPAD_BUTTON_DOWN : SDL_EVENT_GAMEPAD_BUTTON_UP;
+            event.gbutton.button = Uint8(ev.value);
+            event.gbutton.down = ev.kind == "pad";
+        } else if (ev.kind == "stickx" || ev.kind == "sticky") {
+            event.type = SDL_EVENT_GAMEPAD_AXIS_MOTION;
+            event.gaxis.axis = ev.kind == "stickx" ? SDL_GAMEPAD_AXIS_LEFTX : SDL_GAMEPAD_AXIS_LEFTY;
+            event.gaxis.value = Sint16(ev.value);
+        } else if (ev.kind == "text") {
+            // Points into events_, which outlives the event queue.
+            event.type = SDL_EVENT_TEXT_INPUT;
+            event.text.text = ev.text.c_str();
+        } else if (ev.kind == "quit") {
+            event.type = SDL_EVENT_QUIT;
+        } else {
+            std::cerr << "Warning: Unknown replay event '" << ev.kind << "'" << std::endl;
+            return;
+        }
+        SDL_PushEvent(&event);
+    }
+
+    std::vector<InputEvent> events_;
+    size_t recorded_ = 0; // Events from the file, without the final quit.
+    size_t next_ = 0;
+    bool active_ = false;
+};
+
+
+// ===================================================================
+// Texture Memory
+// ===================================================================
+// Every texture the launcher creates is a Texture owned by whatever draws
+// it and accounted for by the TextureManager, which can report what is
+// resident. GPU memory on the Pi comes out of the CMA pool that the
+// launched apps need too, so it is kept within --gpu-budget: the atlas
+// gets what the screen-sized textures leave (see main), and optional
+// textures are refused rather than going over. Text glyphs are cached by
+// SDL_ttf and not counted.
+class TextureManager;
+
+// An owned texture; destroying or resetting it frees the GPU memory.
+class Texture {
+public:
+    Texture() = default;
+    Texture(Texture &&other) noexcept {
+        *this = std::move(other);
+    }
+    Texture &operator=(Texture &&other) noexcept {
+        if (this != &other) {
+            reset();
+            std::swap(manager_, other.manager_);
+            std::swap(texture_, other.texture_);
+            std::swap(purpose_, other.purpose_);
+            std::swap(bytes_, other.bytes_);
+        }
+        return *this;
+    }
+    Texture(const Texture &) = delete;
+    Texture &operator=(const Texture &) = delete;
+    ~Texture() {
+        reset();
+    }
+
+    SDL_Texture* get() const {
+        return texture_;
+    }
+    explicit operator bool() const {
+        return texture_ != nullptr;
+    }
+    void reset();
+
+private:
+    friend class TextureManager;
+    TextureManager* manager_ = nullptr;
+    SDL_Texture* texture_ = nullptr;
+    const char* purpose_ = nullptr;
+    size_t bytes_ = 0;
+};
+
+class TextureManager {
+public:
+    SDL_Renderer* renderer = nullptr; // Set while the renderer exists.
+    size_t budget = 0; // Bytes; 0 means unlimited.
+
+    // Required textures are created even over the budget, with a warning;
+    // optional ones are refused. Failures are logged; the result is empty.
+    Texture create(const char* purpose, int w, int h, SDL_TextureAccess access, bool optional = false) {
+        Texture texture;
+        if (admit(purpose, size_t(w) * h * 4, optional)) {
+            adopt(texture, SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, access, w, h), purpose, w, h);
+        }
+        return texture;
+    }
+
+    Texture upload(const char* purpose, SDL_Surface* surface, bool optional = false) {
+        Texture texture;
+        if (surface && admit(purpose, size_t(surface->w) * surface->h * 4, optional)) {
+            adopt(texture, SDL_CreateTextureFromSurface(renderer, surface), purpose, surface->w, surface->h);
+        }
+        return texture;
+    }
+
+    size_t resident() const {
+        return resident_;
+    }
+
+    // One line: the total, and per purpose the count and size.
+    void report(std::ostream &out) const {
+        auto mib = [](size_t bytes) {
+            char str[32];
+            std::snprintf(str, sizeof(str), "%.1f MiB", bytes / 1048576.0);
+            return std::string(str);
+        };
+        out << "Launcher: Textures: " << mib(resident_);
+        if (budget) {
+            out << " of " << mib(budget);
+        }
+        out << " (peak " << mib(peak_) << ")";
+        const char* sep = ": ";
+        for (const auto &entry : usage_) {
+            if (entry.second.count) {
+                out << sep << entry.first << " " << entry.second.count << " x " << mib(entry.second.bytes / entry.second.count);
+                sep = ", ";
+            }
+        }
+        if (refused_) {
+            out << "; " << refused_ << " refused over budget";
+        }
+        out << std::endl;
+    }
+
+private:
+    friend class Texture;
+
+    struct Usage {
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+    bool admit(const char* purpose, size_t bytes, bool optional) {
+        if (!budget || resident_ + bytes <= budget) {
+            return true;
+        }
+        std::cerr << "Warning: " << purpose << " (" << (bytes >> 10) << " KiB) exceeds the GPU budget of "
+                  << (budget >> 20) << " MiB" << (optional ? "; not created." : ".") << std::endl;
+        if (optional) {
+            refused_++;
+        }
+        return !optional;
+    }
+
+    // Sizes are counted as RGBA, which is what everything here uploads.
+    void adopt(Texture &texture, SDL_Texture* sdl_texture, const char* purpose, int w, int h) {
+        if (!sdl_texture) {
+            std::cerr << "Warning: Could not create " << purpose << ": " << SDL_GetError() << std::endl;
+            return;
+        }
+        texture.manager_ = this;
+        texture.texture_ = sdl_texture;
+        texture.purpose_ = purpose;
+        texture.bytes_ = size_t(w) * h * 4;
+        Usage &usage = usage_[purpose];
+        usage.count++;
+        usage.bytes += texture.bytes_;
+        resident_ += texture.bytes_;
+        peak_ = std::max(peak_, resident_);
+    }
+
+    void release(const Texture &texture) {
+        Usage &usage = usage_[texture.purpose_];
+        usage.count--;
+        usage.bytes -= texture.bytes_;
+        resident_ -= texture.bytes_;
+    }
+
+    std::map<std::string, Usage> usage_;
+    size_t resident_ = 0;
+    size_t peak_ = 0;
+    size_t refused_ = 0;
+};
+
+void Texture::reset() {
+    if (texture_) {
+        SDL_DestroyTexture(texture_);
+        manager_->release(*this);
+    }
+    manager_ = nullptr;
+    texture_ = nullptr;
+    purpose_ = nullptr;
+    bytes_ = 0;
+}
+
+
+// ===================================================================
+// Texture Atlas
+// ===================================================================
+// All icons are packed into a few large pages, so a whole frame can be
+// submitted as one SDL_RenderGeometry call per page instead of one draw
+// (plus color-mod state change) per icon.
+struct AtlasRegion {
+    int page = -1; // -1 means there is nothing to draw.
+    SDL_Rect rect = {0, 0, 0, 0};
+    int slot_w = 0; // Allocated size; rect may use less of a reused slot.
+    int slot_h = 0;
+};
+
+struct Atlas {
+    static constexpr int PADDING = 1; // Keeps linear filtering from bleeding.
+
+    struct Page {
+        SDL_Surface* pixels = nullptr; // CPU copy, survives the renderer.
+        Texture texture;
+        int shelf_x = 0;
+        int shelf_y = 0;
+        int shelf_h = 0;
+    };
+    static constexpr int SLOT_ALIGN = 16; // Rounding of new slots, so released ones fit more images.
+
+    int page_size = 0;
+    int max_pages = 0; // 0 means unlimited.
+    std::vector<Page> pages;
+    std::vector<AtlasRegion> free_slots; // Released regions, reused first.
+    TextureManager* textures = nullptr; // Set while the page textures exist.
+
+    // Copy (and scale if needed) src into the atlas at w x h pixels, in a
+    // slot of at least min_slot_w x min_slot_h. Returns a region without a
+    // page when it does not fit in max_pages.
+    AtlasRegion add(SDL_Surface* src, int w, int h, int min_slot_w = 0, int min_slot_h = 0) {
+        AtlasRegion region;
+        if (!src || page_size <= 0) {
+            return region;
+        }
+        w = std::min(w, page_size - PADDING);
+        h = std::min(h, page_size - PADDING);
+
+        // Reuse the smallest released slot the image fits in.
+        int best = -1;
+        for (int i = 0; i < int(free_slots.size()); ++i) {
+            const AtlasRegion &f = free_slots[i];
+            if (f.slot_w >= w && f.slot_h >= h
+                && (best < 0 || f.slot_w * f.slot_h < free_slots[best].slot_w * free_slots[best].slot_h)) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            region = free_slots[best];
+            free_slots.erase(free_slots.begin() + best);
+            region.rect.w = w;
+            region.rect.h = h;
+            Page &page = pages[region.page];
+            SDL_Rect slot = {region.rect.x, region.rect.y, region.slot_w, region.slot_h};
+            SDL_FillSurfaceRect(page.pixels, &slot, 0);
+            blit(src, page, region.rect);
+            update_texture(page, slot);
+            return region;
+        }
+
+        // Simple shelf packer: fill rows left to right, open a new page when
+        // the current one is full.
+        const int slot_w = std::min(std::max(w, min_slot_w) + SLOT_ALIGN - 1, page_size - PADDING) / SLOT_ALIGN * SLOT_ALIGN;
+        const int slot_h = std::min(std::max(h, min_slot_h) + SLOT_ALIGN - 1, page_size - PADDING) / SLOT_ALIGN * SLOT_ALIGN;
+        w = std::min(w, slot_w);
+        h = std::min(h, slot_h);
+        Page* page = pages.empty() ? nullptr : &pages.back();
+        if (page && page->shelf_x + slot_w + PADDING > page_size) {
+            page->shelf_x = 0;
+            page->shelf_y += page->shelf_h;
+            page->shelf_h = 0;
+        }
+        if (!page || page->shelf_y + slot_h + PADDING > page_size) {
+            if (max_pages > 0 && int(pages.size()) >= max_pages) {
+                return region;
+            }
+            Page new_page;
+            new_page.pixels = SDL_CreateSurface(page_size, page_size, SDL_PIXELFORMAT_RGBA32);
+            if (!new_page.pixels) {
+                std::cerr << "Warning: Could not allocate atlas page: " << SDL_GetError() << std::endl;
+                return region;
+            }
+            if (textures) {
+                new_page.texture = create_texture(new_page.pixels);
+            }
+            pages.push_back(std::move(new_page));
+            page = &pages.back();
+        }
+
+        region.page = int(pages.size()) - 1;
+        region.rect = {page->shelf_x, page->shelf_y, w, h};
+        region.slot_w = slot_w;
+        region.slot_h = slot_h;
+        blit(src, *page, region.rect);
+        page->shelf_x += slot_w + PADDING;
+        page->shelf_h = std::max(page->shelf_h, slot_h + PADDING);
+        update_texture(*page, region.rect);
+        return region;
+    }
+
+    // Give a region's slot back for reuse by later add() calls.
+    void release(AtlasRegion &region) {
+        if (region.page >= 0) {
+            free_slots.push_back(region);
+        }
+        region = AtlasRegion();
+    }
+
+    static void blit(SDL_Surface* src, Page &page, SDL_Rect &rect) {
+        SDL_SetSurfaceBlendMode(src, SDL_BLENDMODE_NONE); // Copy alpha as is.
+        if (src->w == rect.w && src->h == rect.h) {
+            SDL_BlitSurface(src, NULL, page.pixels, &rect);
+        } else {
+            SDL_BlitSurfaceScaled(src, NULL, page.pixels, &rect, SDL_SCALEMODE_LINEAR);
+        }
+    }
+
+    static void update_texture(Page &page, const SDL_Rect &rect) {
+        if (page.texture) {
+            const Uint8* pixels = static_cast<const Uint8*>(page.pixels->pixels)
+                                + rect.y * page.pixels->pitch + rect.x * 4;
+            SDL_UpdateTexture(page.texture.get(), &rect, pixels, page.pixels->pitch);
+        }
+    }
+
+    // Pages are bounded by max_pages rather than refused by the manager.
+    Texture create_texture(SDL_Surface* pixels) {
+        Texture texture = textures->upload("atlas page", pixels);
+        if (texture) {
+            SDL_SetTextureScaleMode(texture.get(), SDL_SCALEMODE_LINEAR);
+            SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+        }
+        return texture;
+    }
+
+    void upload(TextureManager &manager) {
+        textures = &manager;
+        for (auto &page : pages) {
+            page.texture = create_texture(page.pixels);
+        }
+    }
+
+    void release_textures() {
+        for (auto &page : pages) {
+            page.texture.reset();
+        }
+        textures = nullptr;
+    }
+
+    void clear() {
+        release_textures();
+        for (auto &page : pages) {
+            SDL_DestroySurface(page.pixels);
+        }
+        pages.clear();
+        free_slots.clear();
+    }
+};
+
+// Collects the quads of one frame, grouped per atlas page. The dimming of
+// unselected items is carried in the vertex colors.
+struct QuadBatch {
+    struct PageGeometry {
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+    std::vector<PageGeometry> pages;
+
+    void clear() {
+        for (auto &pg : pages) {
+            pg.vertices.clear();
+            pg.indices.clear();
+        }
+    }
+
+    void add(const Atlas &atlas, const AtlasRegion &region, const SDL_FRect &dst, Uint8 brightness) {
+        if (region.page < 0) {
+            return;
+        }
+        if (int(pages.size()) <= region.page) {
+            pages.resize(region.page + 1);
+        }
+        PageGeometry &pg = pages[region.page];
+        const float inv = 1.0f / atlas.page_size;
+        const float u0 = region.rect.x * inv;
+        const float v0 = region.rect.y * inv;
+        const float u1 = (region.rect.x + region.rect.w) * inv;
+        const float v1 = (region.rect.y + region.rect.h) * inv;
+        const float c = brightness / 255.0f;
+        const SDL_FColor color = {c, c, c, 1.0f};
+        const int base = int(pg.vertices.size());
+        pg.vertices.push_back({{dst.x, dst.y}, color, {u0, v0}});
+        pg.vertices.push_back({{dst.x + dst.w, dst.y}, color, {u1, v0}});
+        pg.vertices.push_back({{dst.x + dst.w, dst.y + dst.h}, color, {u1, v1}});
+        pg.vertices.push_back({{dst.x, dst.y + dst.h}, color, {u0, v1}});
+        for (int i : {0, 1, 2, 0, 2, 3}) {
+            pg.indices.push_back(base + i);
+        }
+    }
+
+    void draw(SDL_Renderer* renderer, const Atlas &atlas) {
+        for (size_t p = 0; p < pages.size() && p < atlas.pages.size(); ++p) {
+            const PageGeometry &pg = pages[p];
+            if (pg.indices.empty() || !atlas.pages[p].texture) {
+                continue;
+            }
+            SDL_RenderGeometry(renderer, atlas.pages[p].texture.get(),
+                               pg.vertices.data(), int(pg.vertices.size()),
+                               pg.indices.data(), int(pg.indices.size()));
+        }
+    }
+};
+
+
 // ===================================================================
 // Helper Struct for Rendering
 // ===================================================================
-// This struct will hold the pre-loaded textures to avoid reloading every frame.
-struct MenuItem {
-    std::string name;
-    SDL_Texture* icon_texture = nullptr;
-    SDL_Texture* text_texture = nullptr;
-    int text_width = 0;
-    int text_height = 0;
+// The per-launch menu state of an item. Its icon lives in ResidentAssets,
+// as it is only loaded while the item is near the viewport.
+struct MenuItem {
+    std::string name;
+    int num_variants = 0;
+    int selected_variant = 0;
+
+    // Created when first drawn, until the renderer goes away.
+    TTF_Text* label = nullptr;
+    std::vector<TTF_Text*> variant_labels;
+};
+
+static void free_menu_labels(std::vector<MenuItem> &items) {
+    for (auto &item : items) {
+        TTF_DestroyText(item.label);
+        item.label = nullptr;
+        for (TTF_Text* text : item.variant_labels) {
+            TTF_DestroyText(text);
+        }
+        item.variant_labels.clear();
+    }
+}
+
+
+// ===================================================================
+// Display Mode
+// ===================================================================
+// Which fullscreen mode to use, and what resolution to render the menu at.
+// "current" keeps the desktop mode, which avoids a modeset (and its
+// flicker and delay) altogether. Rendering below the output resolution
+// goes through a render target that is scaled up at present, which saves
+// fill rate on weak GPUs driving large TVs.
+struct ModePolicy {
+    enum Kind { MAX, CURRENT, EXPLICIT };
+    Kind kind = MAX;
+    int w = 0;              // For EXPLICIT: the largest mode that fits.
+    int h = 0;
+    float refresh = 0.0f;   // Preferred refresh rate; 0 picks the highest the size offers.
+    int render_height = 0;  // Internal render height; 0 renders at output size.
+};
+
+// Parses "max", "current" or "WxH[@HZ]".
+static bool parse_mode_policy(const char* str, ModePolicy &policy) {
+    if (std::strcmp(str, "max") == 0) {
+        policy.kind = ModePolicy::MAX;
+        return true;
+    }
+    if (std::strcmp(str, "current") == 0) {
+        policy.kind = ModePolicy::CURRENT;
+        return true;
+    }
+    float refresh = 0.0f;
+    int n = std::sscanf(str, "%dx%d@%f", &policy.w, &policy.h, &refresh);
+    if (n < 2 || policy.w <= 0 || policy.h <= 0) {
+        return false;
+    }
+    if (n == 3) {
+        policy.refresh = refresh;
+    }
+    policy.kind = ModePolicy::EXPLICIT;
+    return true;
+}
+
+// Switch the window to the mode the policy asks for.
+static void apply_mode_policy(SDL_Window* window, const ModePolicy &policy) {
+    SDL_DisplayID display = SDL_GetDisplayForWindow(window);
+    int num_modes = 0;
+    SDL_DisplayMode **modes = SDL_GetFullscreenDisplayModes(display, &num_modes);
+    for (int i = 0; i < num_modes; ++i) {
+        SDL_DisplayMode *m = modes[i];
+        std::cout << "Mode: " << m->w << "x" << m->h << "@" << m->refresh_rate << std::endl;
+    }
+
+    // WxH is a limit: the largest mode that fits in it, and of those sizes
+    // the rate closest to the one asked for (the highest without one).
+    // SDL's closest-mode lookup would pick the next larger size instead.
+    SDL_DisplayMode mode;
+    bool found = false;
+    if (policy.kind == ModePolicy::EXPLICIT) {
+        for (int i = 0; i < num_modes; ++i) {
+            const SDL_DisplayMode *m = modes[i];
+            if (m->w > policy.w || m->h > policy.h) {
+                continue;
+            }
+            const Sint64 area = Sint64(m->w) * m->h, best_area = found ? Sint64(mode.w) * mode.h : 0;
+            const bool faster = policy.refresh > 0.0f
+                ? std::abs(m->refresh_rate - policy.refresh) < std::abs(mode.refresh_rate - policy.refresh)
+                : m->refresh_rate > mode.refresh_rate;
+            if (!found || area > best_area || (m->w == mode.w && m->h == mode.h && faster)) {
+                mode = *m;
+                found = true;
+            }
+        }
+        if (!found && num_modes > 0) {
+            mode = *modes[num_modes - 1];
+            found = true;
+            std::cerr << "Warning: No display mode fits in " << policy.w << "x" << policy.h
+                      << "; using the smallest one." << std::endl;
+        } else if (found && (mode.w != policy.w || mode.h != policy.h)) {
+            std::cerr << "Warning: No " << policy.w << "x" << policy.h << " display mode; using "
+                      << mode.w << "x" << mode.h << "." << std::endl;
+        }
+    }
+    if (!found && policy.kind != ModePolicy::CURRENT && num_modes > 0) {
+        // Modes are sorted largest and fastest first.
+        mode = *modes[0];
+        found = true;
+    }
+    SDL_free(modes);
+
+    if (found) {
+        std::cout << "Display mode: " << mode.w << "x" << mode.h << "@" << mode.refresh_rate << std::endl;
+        SDL_SetWindowFullscreenMode(window, &mode);
+    } else {
+        const SDL_DisplayMode *desktop = SDL_GetDesktopDisplayMode(display);
+        if (desktop) {
+            std::cout << "Display mode: " << desktop->w << "x" << desktop->h << "@" << desktop->refresh_rate
+                      << " (desktop)" << std::endl;
+        }
+        SDL_SetWindowFullscreenMode(window, NULL);
+    }
+    SDL_SyncWindow(window);
+}
+
+
+// ===================================================================
+// Layout
+// ===================================================================
+// Every size used by the menu is derived from the output resolution.
+struct Layout {
+    int screen_w = 0;
+    int screen_h = 0;
+    int icon_base_size = 0;
+    int icon_spacing = 0;
+    float selected_scale = 1.3f;
+    int text_y_offset = 0;
+    int font_size = 0;
+    int icon_max_size = 0; // Largest size an icon is ever drawn at.
+    int wrap_width = 0;    // Width app names are wrapped at.
+
+    bool operator==(const Layout&) const = default;
+};
+
+static Layout compute_layout(int screen_w, int screen_h) {
+    Layout l;
+    l.screen_w = screen_w;
+    l.screen_h = screen_h;
+    l.icon_base_size = screen_h / 8;
+    l.icon_spacing = screen_h / 12;
+    l.text_y_offset = screen_h / 30;
+    l.font_size = screen_h / 40;
+    l.icon_max_size = static_cast<int>(l.icon_base_size * l.selected_scale);
+    l.wrap_width = int(l.icon_base_size * 1.2);
+    return l;
+}
+
+
+// ===================================================================
+// Embedded Assets
+// ===================================================================
+// `make launcher-embedded` builds ./launcher-embedded with a default font,
+// bg.png and the icons next to the Makefile compiled in, as byte arrays
+// generated with xxd (embedded_assets.h). The font is then used without looking for one on
+// disk, and images that are missing on disk are decoded from memory.
+// Files on disk still win, so they can be changed without a rebuild.
+struct EmbeddedFile {
+    const char* name;
+    const unsigned char* data;
+    size_t size;
+};
+
+#ifdef EMBED_ASSETS
+#include "embedded_assets.h" // embedded_font, embedded_files[]
+#endif
+
+static const EmbeddedFile* find_embedded_file(const std::string &name) {
+#ifdef EMBED_ASSETS
+    for (const EmbeddedFile &file : embedded_files) {
+        if (name == file.name) {
+            return &file;
+        }
+    }
+#endif
+    return nullptr;
+}
+
+
+// ===================================================================
+// Item Images
+// ===================================================================
+static const std::vector<const char*> font_paths = {
+#if __APPLE__
+    "/System/Library/Fonts/Geneva.ttf",
+    "/System/Library/Fonts/NewYork.ttf"
+#else
+    "/usr/share/fonts/dejavu-sans-fonts/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/liberation/LiberationSans-Regular.ttf",
+    "/usr/share/fonts/corefonts/arial.ttf", // Common on some systems
+    "/usr/share/fonts/TTF/DejaVuSans.ttf" // Fallback path
+#endif
+};
+
+// The embedded font if there is one, otherwise the first of font_paths that
+// opens. The path found is remembered for the rest of the process.
+static TTF_Font* open_font(int font_size) {
+#ifdef EMBED_ASSETS
+    TTF_Font* embedded = TTF_OpenFontIO(SDL_IOFromConstMem(embedded_font.data, embedded_font.size), true, font_size);
+    if (embedded) {
+        return embedded;
+    }
+    std::cerr << "Warning: Could not open the embedded font: " << SDL_GetError() << std::endl;
+#endif
+    static const char* found_path = nullptr;
+    if (found_path) {
+        return TTF_OpenFont(found_path, font_size);
+    }
+    ProfileScope scope("font probing");
+    for (const auto& path : font_paths) {
+        TTF_Font* font = TTF_OpenFont(path, font_size);
+        if (font) {
+            std::cout << "Loaded font: " << path << std::endl;
+            found_path = path;
+            return font;
+        }
+    }
+    std::cerr << "Error: Could not load any system font: " << SDL_GetError() << std::endl;
+    return nullptr;
+}
+
+// Decode an image file, or its embedded copy when the file can't be read.
+static SDL_Surface* load_image(const std::string &path) {
+    SDL_Surface* image = IMG_Load(path.c_str());
+    if (!image) {
+        if (const EmbeddedFile* file = find_embedded_file(path)) {
+            image = IMG_Load_IO(SDL_IOFromConstMem(file->data, file->size), true);
+        }
+    }
+    return image;
+}
+
+// Convert a decoded image to RGBA32 at exactly w x h pixels.
+static SDL_Surface* scale_image(SDL_Surface* decoded, int w, int h) {
+    SDL_Surface* scaled = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (scaled) {
+        SDL_SetSurfaceBlendMode(decoded, SDL_BLENDMODE_NONE);
+        SDL_BlitSurfaceScaled(decoded, NULL, scaled, NULL, SDL_SCALEMODE_LINEAR);
+    }
+    return scaled;
+}
+
+static SDL_Surface* load_scaled_image(const char* path, int w, int h) {
+    ProfileScope scope(std::string("icon: ") + path);
+    SDL_Surface* decoded = load_image(path);
+    if (!decoded) {
+        return nullptr;
+    }
+    SDL_Surface* scaled = scale_image(decoded, w, h);
+    SDL_DestroySurface(decoded);
+    return scaled;
+}
+
+// The images of one app before they are packed into the atlas: the icon
+// scaled to its largest on-screen size. Labels are not images; they are
+// laid out from the shared glyph cache (see Text).
+struct ItemImages {
+    SDL_Surface* icon = nullptr;
+};
+
+static void free_item_images(ItemImages &images) {
+    SDL_DestroySurface(images.icon);
+    images = ItemImages();
+}
+
+static ItemImages render_item_images(const App &app, const Layout &layout) {
+    ItemImages images;
+    images.icon = load_scaled_image(app.icon_path.c_str(), layout.icon_max_size, layout.icon_max_size);
+    if (!images.icon) {
+        std::cerr << "Warning: Could not load icon " << app.icon_path << ": " << SDL_GetError() << std::endl;
+    }
+    return images;
+}
+
+
+// ===================================================================
+// Text
+// ===================================================================
+// All text is drawn through SDL_ttf's renderer text engine. Glyphs are
+// rasterized once into the engine's own atlas and shared by every string,
+// so a label costs a few quads instead of a texture, and updating a string
+// (TTF_SetTextString) only lays out glyphs again.
+struct TextEngine {
+    TTF_TextEngine* engine = nullptr;
+    TTF_Font* font = nullptr;
+    int font_size = 0;
+
+    bool create(SDL_Renderer* renderer, const Layout &layout) {
+        if (!font || font_size != layout.font_size) {
+            TTF_CloseFont(font);
+            font = open_font(layout.font_size);
+            if (!font) {
+                return false;
+            }
+            TTF_SetFontWrapAlignment(font, TTF_HORIZONTAL_ALIGN_CENTER);
+            font_size = layout.font_size;
+        }
+        engine = TTF_CreateRendererTextEngine(renderer);
+        if (!engine) {
+            std::cerr << "Error: Could not create text engine: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // The glyph cache lives on the renderer; the font survives a launch.
+    void destroy_engine() {
+        TTF_DestroyRendererTextEngine(engine);
+        engine = nullptr;
+    }
+
+    void close() {
+        destroy_engine();
+        TTF_CloseFont(font);
+        font = nullptr;
+        font_size = 0;
+    }
+
+    // wrap_width 0 keeps the text on one line.
+    TTF_Text* create_text(const std::string &str, int wrap_width = 0) {
+        if (!engine) {
+            return nullptr;
+        }
+        TTF_Text* text = TTF_CreateText(engine, font, str.c_str(), str.length());
+        if (!text) {
+            std::cerr << "Warning: Could not create text for " << str << ": " << SDL_GetError() << std::endl;
+            return nullptr;
+        }
+        if (wrap_width > 0) {
+            TTF_SetTextWrapWidth(text, wrap_width);
+        }
+        return text;
+    }
+
+    static SDL_Point size(TTF_Text* text) {
+        SDL_Point size = {0, 0};
+        if (text) {
+            TTF_GetTextSize(text, &size.x, &size.y);
+        }
+        return size;
+    }
+
+    static void draw(TTF_Text* text, float x, float y, Uint8 brightness) {
+        if (text) {
+            TTF_SetTextColor(text, brightness, brightness, brightness, 255);
+            TTF_DrawRendererText(text, x, y);
+        }
+    }
+};
+
+
+// ===================================================================
+// Asset Loader
+// ===================================================================
+// Decodes and scales icons on a small worker pool. Decoding starts right
+// after apps.conf is parsed, so it overlaps with SDL and display setup;
+// scaling follows as soon as the layout is known. Packing into the atlas
+// and uploading stay on the render thread, which picks up finished items
+// with poll() while the menu is running.
+
+// Items decoded while the display is still being set up, before the layout
+// (and so what is on screen) is known.
+static const size_t PRESTART_ITEMS = 16;
+
+class AssetLoader {
+public:
+    struct Result {
+        int index = -1; // App index, or -1 for the background.
+        SDL_Surface* background = nullptr;
+        ItemImages images;
+    };
+
+    // Pushed (when non-zero) whenever a result becomes available, so an
+    // idle event loop wakes up for it.
+    std::atomic<Uint32> wake_event{0};
+
+    ~AssetLoader() {
+        stop();
+    }
+
+    // Started early and still decoding/waiting for set_layout().
+    bool waiting_for_layout() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !threads_.empty() && !has_layout_ && !stopping_;
+    }
+
+    // Items (plus the background) not yet handed out by poll().
+    bool busy() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !threads_.empty() && (undelivered_ > 0 || !results_.empty());
+    }
+
+    // Switch to a new app list and load the given apps (and optionally the
+    // background); result indices are positions in apps. More apps are
+    // loaded on demand with request().
+    void start(const std::vector<App> &apps, const std::vector<int> &indices, bool background) {
+        stop();
+        apps_ = apps;
+        decoded_.assign(apps.size(), nullptr);
+        decode_done_.assign(apps.size(), false);
+        has_layout_ = false;
+        if (background) {
+            request_background();
+        }
+        request(indices);
+    }
+
+    void request_background() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            undelivered_++;
+            jobs_.push_back([this]() { decode_background(); });
+        }
+        request({});
+    }
+
+    // Queue more apps of the current list. The workers are (re)started on
+    // demand and stay around until stop().
+    void request(const std::vector<int> &indices) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i : indices) {
+                jobs_.push_back([this, i]() { decode_icon(i); });
+            }
+            undelivered_ += int(indices.size());
+            cv_.notify_all();
+            if (!threads_.empty() || undelivered_ == 0) {
+                return;
+            }
+        }
+        unsigned num_threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned i = 0; i < num_threads; ++i) {
+            threads_.emplace_back(&AssetLoader::worker, this);
+        }
+    }
+
+    // Queue the layout dependent work: icon scaling.
+    void set_layout(const Layout &layout) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        layout_ = layout;
+        has_layout_ = true;
+        for (size_t i = 0; i < apps_.size(); ++i) {
+            if (decode_done_[i]) {
+                jobs_.push_back([this, i]() { finish_item(i); });
+            }
+        }
+        if (background_done_) {
+            jobs_.push_back([this]() { finish_background(); });
+        }
+        cv_.notify_all();
+    }
+
+    bool poll(Result &out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (results_.empty()) {
+            return false;
+        }
+        out = std::move(results_.front());
+        results_.pop_front();
+        return true;
+    }
+
+    // Drop all queued and undelivered work and let the workers exit. The
+    // app list is kept, so request() can pick up again later.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            jobs_.clear();
+        }
+        cv_.notify_all();
+        for (auto &t : threads_) {
+            t.join();
+        }
+        threads_.clear();
+        // A decode that finished during the join may have queued its finish
+        // job; it would deliver an empty result after a restart.
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.clear();
+            stopping_ = false;
+        }
+        undelivered_ = 0;
+        for (SDL_Surface* &s : decoded_) {
+            SDL_DestroySurface(s);
+            s = nullptr;
+        }
+        decode_done_.assign(decode_done_.size(), false);
+        SDL_DestroySurface(decoded_background_);
+        decoded_background_ = nullptr;
+        background_done_ = false;
+        for (auto &r : results_) {
+            SDL_DestroySurface(r.background);
+            free_item_images(r.images);
+        }
+        results_.clear();
+    }
+
+private:
+    using Job = std::function<void()>;
+
+    void worker() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_) {
+                    break;
+                }
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+            job();
+        }
+    }
+
+    void decode_icon(size_t i) {
+        Uint64 t = Profiler::now_ns();
+        SDL_Surface* icon = load_image(apps_[i].icon_path);
+        profiler.add("icon: " + apps_[i].icon_path, t);
+        if (!icon) {
+            std::cerr << "Warning: Could not load icon " << apps_[i].icon_path << ": " << SDL_GetError() << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        decoded_[i] = icon;
+        decode_done_[i] = true;
+        if (has_layout_) {
+            jobs_.push_back([this, i]() { finish_item(i); });
+            cv_.notify_one();
+        }
+    }
+
+    void decode_background() {
+        Uint64 t = Profiler::now_ns();
+        SDL_Surface* bg = load_image("bg.png");
+        profiler.add("icon: bg.png", t);
+        if (!bg) {
+            std::cerr << "Warning: Could not load background bg.png: " << SDL_GetError() << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        decoded_background_ = bg;
+        background_done_ = true;
+        if (has_layout_) {
+            jobs_.push_back([this]() { finish_background(); });
+            cv_.notify_one();
+        }
+    }
+
+    // The background is only ever drawn at screen size; uploading it any
+    // larger would just take GPU memory.
+    void finish_background() {
+        SDL_Surface* decoded;
+        Layout layout;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            decoded = decoded_background_;
+            decoded_background_ = nullptr;
+            background_done_ = false;
+            layout = layout_;
+        }
+
+        Result r;
+        if (decoded) {
+            ProfileScope scope("icon scale: bg.png");
+            r.background = scale_image(decoded, layout.screen_w, layout.screen_h);
+            SDL_DestroySurface(decoded);
+        }
+        deliver(std::move(r));
+    }
+
+    void finish_item(size_t i) {
+        SDL_Surface* decoded;
+        Layout layout;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            decoded = decoded_[i];
+            decoded_[i] = nullptr;
+            decode_done_[i] = false;
+            layout = layout_;
+        }
+
+        Result r;
+        r.index = int(i);
+        if (decoded) {
+            ProfileScope scope("icon scale: " + apps_[i].icon_path);
+            r.images.icon = scale_image(decoded, layout.icon_max_size, layout.icon_max_size);
+            SDL_DestroySurface(decoded);
+        }
+        deliver(std::move(r));
+    }
+
+    void deliver(Result r) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            results_.push_back(std::move(r));
+            undelivered_--;
+        }
+        if (Uint32 type = wake_event.load()) {
+            SDL_Event event = {};
+            event.type = type;
+            SDL_PushEvent(&event);
+        }
+    }
+
+    std::vector<App> apps_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    std::deque<Result> results_;
+    std::vector<SDL_Surface*> decoded_;
+    std::vector<bool> decode_done_;
+    SDL_Surface* decoded_background_ = nullptr;
+    bool background_done_ = false;
+    Layout layout_;
+    bool has_layout_ = false;
+    bool stopping_ = false;
+    int undelivered_ = 0;
+};
+
+
+// ===================================================================
+// Baked Asset Cache
+// ===================================================================
+// `launcher --bake[=WxH]` writes assets.cache: the background at output
+// size and every icon pre-scaled, as raw RGBA. At startup the file is
+// mmapped and uploaded from directly, which skips PNG decoding and
+// scaling. It is ignored when it was baked for
+// another resolution or when any file it was built from has changed.
+static const char* ASSET_CACHE_PATH = "assets.cache";
+static const char ASSET_CACHE_MAGIC[8] = {'R', 'P', 'I', 'L', 'C', 'A', 'C', 'H'};
+static const Uint32 ASSET_CACHE_VERSION = 2;
+
+struct AssetCacheHeader {
+    char magic[8];
+    Uint32 version;
+    Uint32 screen_w;
+    Uint32 screen_h;
+    Uint32 font_size;
+    Uint32 icon_size;
+    Uint32 wrap_width;
+    Uint32 num_sources;
+    Uint32 num_images;
+    Uint64 sources_offset; // num_sources x (AssetCacheSource + path bytes)
+    Uint64 images_offset;  // num_images x AssetCacheImage
+};
+
+// A file the cache was built from, with its modification time (-1: missing).
+struct AssetCacheSource {
+    Sint64 mtime_ns;
+    Uint32 path_len;
+    Uint32 reserved;
+};
+
+// Tightly packed RGBA32 pixels; w == 0 when there was no image.
+// Order: background, then the icon of each app.
+struct AssetCacheImage {
+    Uint32 w;
+    Uint32 h;
+    Uint64 offset;
+};
+
+struct AssetCache {
+    void* data = nullptr;
+    size_t size = 0;
+    const AssetCacheImage* images = nullptr;
+    Uint32 num_images = 0;
+
+    // A surface pointing straight into the mapping, or nullptr.
+    SDL_Surface* image(Uint32 index) const {
+        if (index >= num_images || images[index].w == 0) {
+            return nullptr;
+        }
+        const AssetCacheImage &img = images[index];
+        void* pixels = static_cast<char*>(data) + img.offset;
+        return SDL_CreateSurfaceFrom(int(img.w), int(img.h), SDL_PIXELFORMAT_RGBA32, pixels, int(img.w * 4));
+    }
+
+    void close() {
+        if (data) {
+            munmap(data, size);
+        }
+        data = nullptr;
+        size = 0;
+        images = nullptr;
+        num_images = 0;
+    }
+};
+
+static Sint64 file_mtime_ns(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+    return Sint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+static Uint32 asset_cache_image_count(const std::vector<App> &apps) {
+    return 1 + Uint32(apps.size()); // Background and icons
+}
+
+static bool bake_asset_cache(const std::vector<App> &apps, const Layout &layout) {
+    std::vector<std::string> sources = {"apps.conf", "bg.png"};
+    std::vector<SDL_Surface*> images;
+    images.push_back(load_scaled_image("bg.png", layout.screen_w, layout.screen_h));
+    for (const auto &app : apps) {
+        sources.push_back(app.icon_path);
+        images.push_back(render_item_images(app, layout).icon);
+    }
+
+    AssetCacheHeader header = {};
+    std::memcpy(header.magic, ASSET_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ASSET_CACHE_VERSION;
+    header.screen_w = layout.screen_w;
+    header.screen_h = layout.screen_h;
+    header.font_size = layout.font_size;
+    header.icon_size = layout.icon_max_size;
+    header.wrap_width = layout.wrap_width;
+    header.num_sources = sources.size();
+    header.num_images = images.size();
+    header.sources_offset = sizeof(AssetCacheHeader);
+    Uint64 offset = header.sources_offset;
+    for (const auto &src : sources) {
+        offset += sizeof(AssetCacheSource) + src.size();
+    }
+    header.images_offset = (offset + 15) & ~Uint64(15);
+    offset = header.images_offset + images.size() * sizeof(AssetCacheImage);
+
+    std::vector<AssetCacheImage> table(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        offset = (offset + 15) & ~Uint64(15);
+        table[i] = {0, 0, offset};
+        if (images[i]) {
+            table[i].w = images[i]->w;
+            table[i].h = images[i]->h;
+            offset += Uint64(images[i]->w) * images[i]->h * 4;
+        }
+    }
+
+    std::string tmp_path = std::string(ASSET_CACHE_PATH) + ".tmp";
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    auto pad_to = [&out](Uint64 pos) {
+        while (Uint64(out.tellp()) < pos) {
+            out.put(0);
+        }
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto &src : sources) {
+        AssetCacheSource rec = {file_mtime_ns(src), Uint32(src.size()), 0};
+        out.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+        out.write(src.data(), src.size());
+    }
+    pad_to(header.images_offset);
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(AssetCacheImage));
+    for (size_t i = 0; i < images.size(); ++i) {
+        SDL_Surface* img = images[i];
+        if (!img) {
+            continue;
+        }
+        pad_to(table[i].offset);
+        SDL_Surface* rgba = img->format == SDL_PIXELFORMAT_RGBA32 ? img : SDL_ConvertSurface(img, SDL_PIXELFORMAT_RGBA32);
+        for (int y = 0; rgba && y < rgba->h; ++y) {
+            out.write(static_cast<const char*>(rgba->pixels) + y * rgba->pitch, rgba->w * 4);
+        }
+        if (rgba != img) {
+            SDL_DestroySurface(rgba);
+        }
+        SDL_DestroySurface(img);
+    }
+    out.close();
+    if (!out || std::rename(tmp_path.c_str(), ASSET_CACHE_PATH) != 0) {
+        std::cerr << "Error: Could not write " << ASSET_CACHE_PATH << std::endl;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    std::cout << "Baked " << images.size() << " images for " << layout.screen_w << "x" << layout.screen_h
+              << " into " << ASSET_CACHE_PATH << " (" << offset / 1024 << " KiB)" << std::endl;
+    return true;
+}
+
+// Map the cache and check it still matches the layout and the files on disk.
+// Without a layout only the source files are checked (and nothing logged).
+static bool open_asset_cache(AssetCache &cache, const std::vector<App> &apps, const Layout *layout) {
+    int fd = open(ASSET_CACHE_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(AssetCacheHeader)) {
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    cache.data = data;
+    cache.size = st.st_size;
+
+    const char* base = static_cast<const char*>(data);
+    const AssetCacheHeader &h = *reinterpret_cast<const AssetCacheHeader*>(base);
+    const char* stale = nullptr;
+    if (std::memcmp(h.magic, ASSET_CACHE_MAGIC, sizeof(h.magic)) != 0 || h.version != ASSET_CACHE_VERSION) {
+        stale = "unknown format";
+    } else if (layout && (h.screen_w != Uint32(layout->screen_w) || h.screen_h != Uint32(layout->screen_h)
+               || h.font_size != Uint32(layout->font_size) || h.icon_size != Uint32(layout->icon_max_size)
+               || h.wrap_width != Uint32(layout->wrap_width))) {
+        stale = "baked for another resolution";
+    } else if (h.num_images != asset_cache_image_count(apps) || h.num_sources != 2 + apps.size()
+               || h.images_offset + Uint64(h.num_images) * sizeof(AssetCacheImage) > cache.size) {
+        stale = "app list mismatch";
+    }
+
+    Uint64 pos = h.sources_offset;
+    for (Uint32 i = 0; !stale && i < h.num_sources; ++i) {
+        AssetCacheSource rec;
+        if (pos + sizeof(rec) > cache.size) {
+            stale = "truncated";
+            break;
+        }
+        std::memcpy(&rec, base + pos, sizeof(rec));
+        pos += sizeof(rec);
+        if (pos + rec.path_len > cache.size) {
+            stale = "truncated";
+            break;
+        }
+        std::string path(base + pos, rec.path_len);
+        pos += rec.path_len;
+        // Images are stored by app position, which --order=history and
+        // --discover change without touching any of the files.
+        if (i >= 2 && path != apps[i - 2].icon_path) {
+            stale = "app list mismatch";
+        } else if (file_mtime_ns(path) != rec.mtime_ns) {
+            if (layout) {
+                std::cout << "Asset cache: " << path << " changed since baking." << std::endl;
+            }
+            stale = "source files changed";
+        }
+    }
+
+    if (!stale) {
+        cache.images = reinterpret_cast<const AssetCacheImage*>(base + h.images_offset);
+        cache.num_images = h.num_images;
+        for (Uint32 i = 0; i < cache.num_images; ++i) {
+            const AssetCacheImage &img = cache.images[i];
+            if (img.offset + Uint64(img.w) * img.h * 4 > cache.size) {
+                stale = "truncated";
+                break;
+            }
+        }
+    }
+
+    if (stale) {
+        if (layout) {
+            std::cout << "Asset cache not used: " << stale << "." << std::endl;
+        }
+        cache.close();
+        return false;
+    }
+    if (layout) {
+        std::cout << "Using baked assets from " << ASSET_CACHE_PATH << std::endl;
+    }
+    return true;
+}
+
+
+// ===================================================================
+// Resident Assets
+// ===================================================================
+// CPU-side copies of everything the menu draws. These survive while a
+// launched app owns the display, so returning to the menu only has to
+// re-upload textures instead of decoding PNGs again.
+//
+// Items are only loaded once they come near the viewport, and the atlas is
+// capped at gpu_budget bytes of pages: when it is full, the least recently
+// drawn items outside the viewport are evicted to make room. This keeps
+// startup and memory flat regardless of the number of apps.
+struct ResidentAssets {
+    Layout layout; // Layout the assets below were built for.
+    AssetCache cache;
+    bool from_cache = false; // Items are packed from the baked cache.
+    SDL_Surface* background = nullptr;
+    bool background_pending = false;   // Not loaded yet...
+    bool background_requested = false; // ...but queued on the loader.
+    size_t gpu_budget = 0; // Bytes of atlas pages (set from --gpu-budget); at least one page is used.
+
+    Atlas atlas;
+    struct Item {
+        bool loaded = false;
+        bool requested = false; // Queued on the loader.
+        Uint64 last_used = 0;   // Frame it was last drawn in.
+        Uint64 visible_in = 0;  // Last view it was on screen in...
+        Uint64 kept_in = 0;     // ...or near the screen in.
+        AtlasRegion icon;
+    };
+    std::vector<Item> items;
+
+    // Every request_items() call starts a new view; items on screen in the
+    // current view must stay resident, those near it are worth keeping.
+    Uint64 view = 0;
+    size_t view_first = 0, view_last = 0, view_count = 0;
+    bool budget_full = false; // Stop preloading off-screen items until the view moves.
+    Uint64 frame = 0;
+    Uint64 evictions = 0;
+};
+
+static void release_item(Atlas &atlas, ResidentAssets::Item &item) {
+    atlas.release(item.icon);
+    item = ResidentAssets::Item();
+}
+
+// Evict the least recently drawn item that is not on screen (nor near it,
+// unless allowed), other than the one being packed. Returns false if there
+// is none.
+static bool evict_item(ResidentAssets &res, bool evict_kept, size_t packing) {
+    size_t lru = res.items.size();
+    for (size_t i = 0; i < res.items.size(); ++i) {
+        const ResidentAssets::Item &item = res.items[i];
+        if (item.loaded && i != packing && item.visible_in != res.view && (evict_kept || item.kept_in != res.view)
+            && (lru == res.items.size() || item.last_used < res.items[lru].last_used)) {
+            lru = i;
+        }
+    }
+    if (lru == res.items.size()) {
+        return false;
+    }
+    release_item(res.atlas, res.items[lru]);
+    res.evictions++;
+    return true;
+}
+
+// Pack an item's icon into the atlas, evicting others if it is full. On
+// screen items may push out anything off screen; others only items that
+// are not near the screen either. Icon slots are uniform, so any evicted
+// icon makes room for another.
+static bool pack_item_images(ResidentAssets &res, size_t index, const ItemImages &images) {
+    const int slot = res.layout.icon_max_size;
+    ResidentAssets::Item &item = res.items[index];
+    const bool visible = item.visible_in == res.view;
+    ResidentAssets::Item packed;
+    packed.visible_in = item.visible_in;
+    packed.kept_in = item.kept_in;
+    item = packed;
+    if (SDL_Surface* s = images.icon) {
+        item.icon = res.atlas.add(s, s->w, s->h, slot, slot);
+        while (item.icon.page < 0
+               && (evict_item(res, false, index) || (visible && evict_item(res, true, index)))) {
+            item.icon = res.atlas.add(s, s->w, s->h, slot, slot);
+        }
+        if (item.icon.page < 0) {
+            if (visible && !res.budget_full) {
+                std::cerr << "Warning: The " << (res.gpu_budget >> 20)
+                          << " MiB the GPU budget leaves for icons is too little for the items on screen." << std::endl;
+            }
+            res.budget_full = true;
+            return false;
+        }
+    }
+    item.loaded = true;
+    item.last_used = res.frame;
+    return true;
+}
+
+// (Re)build the resident assets for the given layout. Nothing is loaded
+// yet; that happens in request_items(). Nothing is redone when the layout
+// did not change (e.g. when returning from a launched app).
+static void prepare_resident_assets(ResidentAssets &res, const std::vector<App> &apps,
+                                    const Layout &layout, int page_size, AssetLoader &loader) {
+    if (res.layout == layout && res.items.size() == apps.size()) {
+        return;
+    }
+
+    res.items.clear();
+    res.from_cache = false;
+    res.atlas.clear();
+    res.atlas.page_size = page_size;
+    res.atlas.max_pages = std::max<size_t>(1, res.gpu_budget / (size_t(page_size) * page_size * 4));
+    SDL_DestroySurface(res.background);
+    res.background = nullptr;
+    res.cache.close();
+    res.layout = layout;
+    res.items.resize(apps.size());
+
+    if (open_asset_cache(res.cache, apps, &layout)) {
+        loader.stop();
+        // The images stay in the mapping; items are packed from there.
+        res.background = res.cache.image(0);
+        res.from_cache = true;
+        return;
+    }
+
+    if (loader.waiting_for_layout()) {
+        // Started early on the first items; don't ask for those twice.
+        for (size_t i = 0; i < std::min(apps.size(), PRESTART_ITEMS); ++i) {
+            res.items[i].requested = true;
+        }
+    } else {
+        loader.start(apps, {}, true);
+    }
+    res.background_pending = true;
+    res.background_requested = true;
+    loader.set_layout(layout);
+}
+
+// Make sure the items at positions [first, last] of order are loaded, or
+// on their way, and keep those at [visible_first, visible_last] resident.
+// Items come straight from the baked cache if there is one, otherwise from
+// the loader. Returns whether anything was packed right away.
+static bool request_items(ResidentAssets &res, AssetLoader &loader, const std::vector<int> &order,
+                          size_t visible_first, size_t visible_last, size_t first, size_t last) {
+    const size_t count = order.size();
+    last = std::min(last, count - 1);
+    visible_last = std::min(visible_last, count - 1);
+    if (visible_first != res.view_first || visible_last != res.view_last || count != res.view_count) {
+        res.budget_full = false;
+    }
+    res.view++;
+    res.view_first = visible_first;
+    res.view_last = visible_last;
+    res.view_count = count;
+    for (size_t k = first; k <= last && k < count; ++k) {
+        ResidentAssets::Item &item = res.items[order[k]];
+        item.kept_in = res.view;
+        if (k >= visible_first && k <= visible_last) {
+            item.visible_in = res.view;
+            item.last_used = res.frame;
+        }
+    }
+
+    if (res.background_pending && !res.background_requested) {
+        loader.request_background();
+        res.background_requested = true;
+    }
+
+    bool packed = false;
+    std::vector<int> indices;
+    for (size_t k = first; k <= last && k < count; ++k) {
+        const int i = order[k];
+        ResidentAssets::Item &item = res.items[i];
+        if (item.loaded || item.requested || (res.budget_full && item.visible_in != res.view)) {
+            continue;
+        }
+        if (res.from_cache) {
+            ItemImages images;
+            images.icon = res.cache.image(1 + Uint32(i));
+            packed |= pack_item_images(res, i, images);
+            free_item_images(images);
+        } else {
+            item.requested = true;
+            indices.push_back(i);
+        }
+    }
+    if (!indices.empty()) {
+        loader.request(indices);
+    }
+    return packed;
+}
+
+// Pack whatever the loader finished into the atlas (uploading the touched
+// pages if they already exist). Returns the number of results taken.
+static int take_loaded_assets(ResidentAssets &res, AssetLoader &loader) {
+    int taken = 0;
+    AssetLoader::Result result;
+    while (loader.poll(result)) {
+        if (result.index < 0) {
+            SDL_DestroySurface(res.background);
+            res.background = result.background;
+            res.background_pending = false;
+            res.background_requested = false;
+        } else if (size_t(result.index) < res.items.size()) {
+            res.items[result.index].requested = false;
+            pack_item_images(res, result.index, result.images);
+        }
+        free_item_images(result.images);
+        taken++;
+    }
+    return taken;
+}
+
+// Forget what the loader was still working on, so it is asked again.
+static void cancel_requests(ResidentAssets &res, AssetLoader &loader) {
+    loader.stop();
+    res.background_requested = false;
+    for (auto &item : res.items) {
+        item.requested = false;
+    }
+}
+
+static void free_resident_assets(ResidentAssets &res) {
+    res.items.clear();
+    res.from_cache = false;
+    res.atlas.clear();
+    SDL_DestroySurface(res.background);
+    res.background = nullptr;
+    res.cache.close();
+}
+
+// ===================================================================
+// Configuration
+// ===================================================================
+// Apply env.conf to our own environment (and thus to every launched app).
+// Variables set by an earlier version of the file but no longer in it are
+// removed again, so this can be called on every change.
+static void load_env_conf() {
+    static std::vector<std::string> keys_set;
+    std::vector<std::string> keys;
+    std::ifstream conf("env.conf");
+    if (conf.is_open()) {
+        std::string line;
+        while (!conf.eof()) {
+            std::getline(conf, line);
+            if (line.empty() || conf.eof() || conf.bad()) {
+                continue;
+            }
+            size_t pos = line.find("=");
+            std::string key = line.substr(0, pos);
+            std::string val = line.substr(pos + 1);
+            std::cout << "Set env var '" << key << "' to '" << val.c_str() << "'\n";
+            int ret = setenv(key.c_str(), val.c_str(), true);
+            if (ret) {
+                std::cout << "  => failed: " << ret << std::endl;
+            }
+            keys.push_back(key);
+        }
+    } else {
+        std::cout << "No env.conf file found.\n";
+    }
+    for (const auto &key : keys_set) {
+        if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+            std::cout << "Unset env var '" << key << "'\n";
+            unsetenv(key.c_str());
+        }
+    }
+    keys_set = std::move(keys);
+}
+
+// Parse apps.conf. Returns false when the file could not be opened.
+static bool load_apps_conf(std::vector<App> &apps) {
+    apps.clear();
+    std::ifstream conf("apps.conf");
+    if (!conf.is_open()) {
+        return false;
+    }
+    std::string line;
+    while (!conf.eof()) {
+        App app;
+        std::getline(conf, app.name);
+        std::getline(conf, app.icon_path);
+
+        if (conf.eof()) {
+            break;
+        }
+        std::cout << "Parse program '" << app.name << "' with icon: " << app.icon_path << std::endl;
+        while (true) {
+            std::getline(conf, line);
+            if (line.empty() || conf.eof() || conf.bad()) {
+                // Seperator, new app!
+                apps.emplace_back(std::move(app));
+                break;
+            } else if (line.compare(0, 5, "@env ") == 0) {
+                // Environment override for the app, or for the variant above it
+                std::string kv = line.substr(5);
+                const size_t eq = kv.find('=');
+                if (eq == std::string::npos || eq == 0) {
+                    // An empty key would replace the first inherited variable.
+                    std::cerr << "Warning: Ignoring '" << line << "' for '" << app.name
+                              << "': expected @env KEY=VALUE" << std::endl;
+                    continue;
+                }
+                std::vector<std::string> &env = app.variants.empty() ? app.env : app.variants.back().env;
+                env.push_back(kv);
+                std::cout << "   Env override: " << kv << std::endl;
+            } else {
+                // Variant name
+                App::Variant v;
+                v.variant_name = line;
+                std::getline(conf, v.command);
+                prepare_command(v);
+                std::cout << "   Parse variant '" << v.variant_name << "' with command: " << v.command
+                          << (v.use_shell ? " (shell)" : "") << std::endl;
+                app.variants.emplace_back(std::move(v));
+            }
+        }
+    }
+    return true;
+}
+
+// ===================================================================
+// Application Discovery
+// ===================================================================
+// `launcher --discover` adds the applications installed on the system: the
+// .desktop files in the XDG applications/ directories, with their icons
+// looked up in the hicolor theme and pixmaps. Apps from apps.conf come
+// first; discovered apps with the same name are left out.
+//
+// Reading thousands of .desktop files and listing the icon directories is
+// slow on an SD card, so the result is kept in desktop.cache along with
+// the modification time of every directory that was read, and only scanned
+// again when one of them changed. Installing, removing or upgrading a
+// package replaces files, which updates the directory.
+static const char* DESKTOP_CACHE_PATH = "desktop.cache";
+static const char DESKTOP_CACHE_MAGIC[8] = {'R', 'P', 'I', 'L', 'D', 'E', 'S', 'K'};
+static const Uint32 DESKTOP_CACHE_VERSION = 1;
+
+// Followed by num_dirs x (Sint64 mtime_ns, path), the first num_roots of
+// which are the search roots, then num_apps x (name, icon_path, Uint32
+// num_variants, num_variants x (variant_name, command)). Strings are a
+// Uint32 length and the bytes.
+struct DesktopCacheHeader {
+    char magic[8];
+    Uint32 version;
+    Uint32 num_roots;
+    Uint32 num_dirs;
+    Uint32 num_apps;
+};
+
+// Largest first; icons are scaled down to the layout anyway.
+static const char* DESKTOP_ICON_SIZES[] = {"256x256", "192x192", "128x128", "96x96", "64x64", "48x48", "scalable"};
+
+// The directories to search: applications/ directories, and icon
+// directories in order of preference.
+static void desktop_search_dirs(std::vector<std::string> &app_dirs, std::vector<std::string> &icon_dirs) {
+    const char* home = getenv("HOME");
+    const char* data_home = getenv("XDG_DATA_HOME");
+    const char* data_dirs = getenv("XDG_DATA_DIRS");
+    std::vector<std::string> data;
+    if (data_home && *data_home) {
+        data.push_back(data_home);
+    } else if (home) {
+        data.push_back(std::string(home) + "/.local/share");
+    }
+    std::string list = data_dirs && *data_dirs ? data_dirs : "/usr/local/share:/usr/share";
+    for (size_t start = 0, end; start < list.size(); start = end + 1) {
+        end = std::min(list.find(':', start), list.size());
+        if (end > start) {
+            data.push_back(list.substr(start, end - start));
+        }
+    }
+
+    std::vector<std::string> icon_bases;
+    if (home) {
+        icon_bases.push_back(std::string(home) + "/.icons");
+    }
+    for (const auto &dir : data) {
+        app_dirs.push_back(dir + "/applications");
+        icon_bases.push_back(dir + "/icons");
+    }
+    for (const char* size : DESKTOP_ICON_SIZES) {
+        for (const auto &base : icon_bases) {
+            icon_dirs.push_back(base + "/hicolor/" + size + "/apps");
+        }
+    }
+    for (const auto &dir : data) {
+        icon_dirs.push_back(dir + "/pixmaps");
+    }
+}
+
+// Exec= without field codes (%f, %U, %i, ...); nothing is passed to the app.
+static std::string desktop_exec_command(const std::string &exec) {
+    std::string command;
+    for (size_t i = 0; i < exec.size(); ++i) {
+        if (exec[i] != '%') {
+            command += exec[i];
+        } else if (++i < exec.size() && exec[i] == '%') {
+            command += '%';
+        }
+    }
+    return command;
+}
+
+// Read one .desktop file. Returns false for entries that are not meant to
+// be shown, or can't be started from here (Terminal=true). The entry is
+// the first variant, [Desktop Action]s the others. icon is the Icon= value.
+static bool parse_desktop_file(const std::string &path, App &app, std::string &icon) {
+    std::ifstream in(path);
+    std::string line, section, type, exec;
+    bool show = true;
+    std::vector<App::Variant> actions;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[') {
+            section = line;
+            if (section.compare(0, 16, "[Desktop Action ") == 0) {
+                actions.emplace_back();
+            }
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        size_t key_end = line.find_last_not_of(" \t", eq - 1);
+        std::string key = line.substr(0, key_end == std::string::npos ? 0 : key_end + 1);
+        std::string raw = line.substr(std::min(line.find_first_not_of(" \t", eq + 1), line.size()));
+        std::string value;
+        for (size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] == '\\' && i + 1 < raw.size()) {
+                char c = raw[++i];
+                value += c == 's' ? ' ' : c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c;
+            } else {
+                value += raw[i];
+            }
+        }
+
+        if (section == "[Desktop Entry]") {
+            if (key == "Type") {
+                type = value;
+            } else if (key == "Name") {
+                app.name = value;
+            } else if (key == "Exec") {
+                exec = value;
+            } else if (key == "Icon") {
+                icon = value;
+            } else if ((key == "NoDisplay" || key == "Hidden" || key == "Terminal") && value == "true") {
+                show = false;
+            } else if (key == "OnlyShowIn") {
+                show = false; // Meant for a particular desktop environment.
+            }
+        } else if (!actions.empty() && section.compare(0, 16, "[Desktop Action ") == 0) {
+            if (key == "Name") {
+                actions.back().variant_name = value;
+            } else if (key == "Exec") {
+                actions.back().command = desktop_exec_command(value);
+            }
+        }
+    }
+    if (!show || type != "Application" || app.name.empty() || exec.empty()) {
+        return false;
+    }
+    App::Variant launch;
+    launch.variant_name = "Launch";
+    launch.command = desktop_exec_command(exec);
+    app.variants.push_back(std::move(launch));
+    for (auto &action : actions) {
+        if (!action.variant_name.empty() && !action.command.empty()) {
+            app.variants.push_back(std::move(action));
+        }
+    }
+    return true;
+}
+
+// Scan the applications and icon directories. dirs gets every directory
+// that was read, with its modification time, starting with the roots.
+static std::vector<App> scan_desktop_apps(const std::vector<std::string> &app_dirs,
+                                          const std::vector<std::string> &icon_dirs,
+                                          std::vector<std::pair<std::string, Sint64>> &dirs) {
+    namespace fs = std::filesystem;
+    for (const auto &dir : app_dirs) {
+        dirs.emplace_back(dir, file_mtime_ns(dir));
+    }
+    for (const auto &dir : icon_dirs) {
+        dirs.emplace_back(dir, file_mtime_ns(dir));
+    }
+
+    // Icon name -> file, from the most preferred directory that has it.
+    // Listing each directory once beats probing every size for every app.
+    std::unordered_map<std::string, std::string> icons;
+    for (const auto &dir : icon_dirs) {
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+            const fs::path &file = it->path();
+            std::string ext = file.extension().string();
+            if (ext == ".png" || ext == ".svg" || ext == ".xpm") {
+                icons.emplace(file.stem().string(), file.string());
+            }
+        }
+    }
+
+    // Entries with the same desktop file ID (path below applications/,
+    // '/' replaced with '-') are overridden by the first directory.
+    std::set<std::string> ids;
+    std::vector<App> apps;
+    for (const auto &root : app_dirs) {
+        std::error_code ec;
+        for (fs::recursive_directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->is_directory(ec)) {
+                dirs.emplace_back(it->path().string(), file_mtime_ns(it->path().string()));
+                continue;
+            }
+            if (it->path().extension() != ".desktop") {
+                continue;
+            }
+            std::string id = it->path().lexically_relative(root).string();
+            std::replace(id.begin(), id.end(), '/', '-');
+            if (!ids.insert(id).second) {
+                continue;
+            }
+            App app;
+            std::string icon;
+            if (!parse_desktop_file(it->path().string(), app, icon)) {
+                continue;
+            }
+            if (!icon.empty() && icon[0] == '/') {
+                app.icon_path = icon;
+            } else {
+                fs::path name(icon);
+                std::string ext = name.extension().string();
+                auto found = icons.find(ext == ".png" || ext == ".svg" || ext == ".xpm" ? name.stem().string() : icon);
+                if (found != icons.end()) {
+                    app.icon_path = found->second;
+                }
+            }
+            apps.push_back(std::move(app));
+        }
+    }
+    std::sort(apps.begin(), apps.end(), [](const App &a, const App &b) { return a.name < b.name; });
+    return apps;
+}
+
+static void write_desktop_cache(size_t num_roots, const std::vector<std::pair<std::string, Sint64>> &dirs,
+                                const std::vector<App> &apps) {
+    std::string out;
+    auto put = [&out](const void* data, size_t len) {
+        out.append(static_cast<const char*>(data), len);
+    };
+    auto put_string = [&put](const std::string &str) {
+        Uint32 len = Uint32(str.size());
+        put(&len, sizeof(len));
+        put(str.data(), len);
+    };
+    DesktopCacheHeader header = {};
+    std::memcpy(header.magic, DESKTOP_CACHE_MAGIC, sizeof(header.magic));
+    header.version = DESKTOP_CACHE_VERSION;
+    header.num_roots = Uint32(num_roots);
+    header.num_dirs = Uint32(dirs.size());
+    header.num_apps = Uint32(apps.size());
+    put(&header, sizeof(header));
+    for (const auto &dir : dirs) {
+        put(&dir.second, sizeof(dir.second));
+        put_string(dir.first);
+    }
+    for (const auto &app : apps) {
+        put_string(app.name);
+        put_string(app.icon_path);
+        Uint32 num_variants = Uint32(app.variants.size());
+        put(&num_variants, sizeof(num_variants));
+        for (const auto &variant : app.variants) {
+            put_string(variant.variant_name);
+            put_string(variant.command);
+        }
+    }
+
+    std::string tmp_path = std::string(DESKTOP_CACHE_PATH) + ".tmp";
+    std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    file.close();
+    if (!file || std::rename(tmp_path.c_str(), DESKTOP_CACHE_PATH) != 0) {
+        std::cerr << "Warning: Could not write " << DESKTOP_CACHE_PATH << std::endl;
+        std::remove(tmp_path.c_str());
+    }
+}
+
+// Load the cache in one read, if it was made for these roots and none of
+// the directories it was made from changed since.
+static bool read_desktop_cache(const std::vector<std::string> &roots, std::vector<App> &apps) {
+    std::ifstream file(DESKTOP_CACHE_PATH, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string data(size_t(file.tellg()), '\0');
+    file.seekg(0);
+    if (!file.read(data.data(), data.size())) {
+        return false;
+    }
+    size_t pos = 0;
+    auto get = [&](void* out, size_t len) {
+        if (pos + len > data.size()) {
+            return false;
+        }
+        std::memcpy(out, data.data() + pos, len);
+        pos += len;
+        return true;
+    };
+    auto get_string = [&](std::string &str) {
+        Uint32 len;
+        if (!get(&len, sizeof(len)) || pos + len > data.size()) {
+            return false;
+        }
+        str.assign(data, pos, len);
+        pos += len;
+        return true;
+    };
+
+    DesktopCacheHeader header;
+    if (!get(&header, sizeof(header)) || std::memcmp(header.magic, DESKTOP_CACHE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != DESKTOP_CACHE_VERSION || header.num_roots != roots.size()) {
+        return false;
+    }
+    for (Uint32 i = 0; i < header.num_dirs; ++i) {
+        Sint64 mtime_ns;
+        std::string dir;
+        if (!get(&mtime_ns, sizeof(mtime_ns)) || !get_string(dir)
+            || (i < header.num_roots && dir != roots[i]) || file_mtime_ns(dir) != mtime_ns) {
+            return false;
+        }
+    }
+    std::vector<App> cached(header.num_apps);
+    for (App &app : cached) {
+        Uint32 num_variants;
+        if (!get_string(app.name) || !get_string(app.icon_path) || !get(&num_variants, sizeof(num_variants))
+            || num_variants > data.size() - pos) {
+            return false;
+        }
+        app.variants.resize(num_variants);
+        for (auto &variant : app.variants) {
+            if (!get_string(variant.variant_name) || !get_string(variant.command)) {
+                return false;
+            }
+        }
+    }
+    apps = std::move(cached);
+    return true;
+}
+
+// Add the installed applications that apps doesn't have yet.
+static void discover_apps(std::vector<App> &apps) {
+    std::vector<std::string> app_dirs, icon_dirs;
+    desktop_search_dirs(app_dirs, icon_dirs);
+    std::vector<std::string> roots = app_dirs;
+    roots.insert(roots.end(), icon_dirs.begin(), icon_dirs.end());
+
+    std::vector<App> found;
+    if (!read_desktop_cache(roots, found)) {
+        std::vector<std::pair<std::string, Sint64>> dirs;
+        found = scan_desktop_apps(app_dirs, icon_dirs, dirs);
+        write_desktop_cache(roots.size(), dirs, found);
+        std::cout << "Launcher: Scanned " << dirs.size() << " directories for applications" << std::endl;
+    }
+
+    std::set<std::string> names;
+    for (const auto &app : apps) {
+        names.insert(app.name);
+    }
+    size_t added = 0;
+    for (App &app : found) {
+        if (!names.insert(app.name).second) {
+            continue;
+        }
+        for (auto &variant : app.variants) {
+            prepare_command(variant);
+        }
+        apps.push_back(std::move(app));
+        added++;
+    }
+    std::cout << "Launcher: Discovered " << added << " installed applications" << std::endl;
+}
+
+
+
+// ===================================================================
+// Search Index
+// ===================================================================
+// Type-to-filter over app and variant names. Built once per apps.conf: the
+// lowercased names of every app, and a trigram -> apps posting list. A
+// query only has to check the apps in the smallest posting list of its
+// trigrams, and each typed character narrows down the result of the query
+// before it rather than starting over.
+class SearchIndex {
+public:
+    void build(const std::vector<App> &apps) {
+        texts_.clear();
+        postings_.clear();
+        all_.clear();
+        for (size_t i = 0; i < apps.size(); ++i) {
+            std::string text = lowercase(apps[i].name);
+            for (const auto &variant : apps[i].variants) {
+                text += '\n' + lowercase(variant.variant_name);
+            }
+            for (size_t k = 0; k + 3 <= text.size(); ++k) {
+                if (std::memchr(text.data() + k, '\n', 3)) {
+                    continue; // Spans two names.
+                }
+                std::vector<int> &list = postings_[trigram(text.data() + k)];
+                if (list.empty() || list.back() != int(i)) {
+                    list.push_back(int(i));
+                }
+            }
+            texts_.push_back(std::move(text));
+            all_.push_back(int(i));
+        }
+    }
+
+    // All apps, in order.
+    const std::vector<int> &all() const {
+        return all_;
+    }
+
+    // The apps out of within (sorted, e.g. the result for a prefix of the
+    // query) whose name or variant names contain query, ignoring case.
+    std::vector<int> filter(const std::string &query, const std::vector<int> &within) const {
+        const std::string q = lowercase(query);
+        const std::vector<int>* candidates = &within;
+        std::vector<int> narrowed;
+        if (q.size() >= 3) {
+            const std::vector<int>* smallest = nullptr;
+            for (size_t k = 0; k + 3 <= q.size(); ++k) {
+                auto it = postings_.find(trigram(q.data() + k));
+                if (it == postings_.end()) {
+                    return {};
+                }
+                if (!smallest || it->second.size() < smallest->size()) {
+                    smallest = &it->second;
+                }
+            }
+            std::set_intersection(within.begin(), within.end(), smallest->begin(), smallest->end(),
+                                  std::back_inserter(narrowed));
+            candidates = &narrowed;
+        }
+        std::vector<int> result;
+        for (int i : *candidates) {
+            if (texts_[i].find(q) != std::string::npos) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    }
+
+private:
+    static std::string lowercase(const std::string &str) {
+        std::string out = str;
+        for (char &c : out) {
+            if (c >= 'A' && c <= 'Z') {
+                c = char(c - 'A' + 'a');
+            }
+        }
+        return out;
+    }
+
+    static Uint32 trigram(const char* p) {
+        return Uint32(Uint8(p[0])) | Uint32(Uint8(p[1])) << 8 | Uint32(Uint8(p[2])) << 16;
+    }
+
+    std::vector<std::string> texts_;
+    std::unordered_map<Uint32, std::vector<int>> postings_;
+    std::vector<int> all_;
+};
+
+
+// ===================================================================
+// Config Watcher
+// ===================================================================
+// Watches apps.conf, env.conf, bg.png and every icon with inotify. A thread
+// blocks on the inotify descriptor, waits for a burst of changes to settle
+// and then wakes the event loop with an SDL event; the loop collects the
+// changed paths with take_changes(). Directories are watched rather than
+// the files themselves, so editors that replace files are handled too.
+class ConfigWatcher {
+public:
+    std::atomic<Uint32> wake_event{0};
 
-    struct Variant {
-        int text_width = 0;
-        int text_height = 0;
-        SDL_Texture* text_texture = nullptr;
-    };
-    std::vector<Variant> variants;
-    int selected_variant = 0;
+    ~ConfigWatcher() {
+        stop();
+    }
+
+    bool start() {
+        fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+        if (fd_ < 0 || pipe2(stop_pipe_, O_CLOEXEC) != 0) {
+            std::cerr << "Warning: Config watching unavailable: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        thread_ = std::thread(&ConfigWatcher::run, this);
+        return true;
+    }
+
+    // (Re)set the files to watch, relative to the working directory.
+    void watch(const std::vector<App> &apps) {
+        if (fd_ < 0) {
+            return;
+        }
+        std::set<std::string> files = {"apps.conf", "env.conf", "bg.png"};
+        for (const auto &app : apps) {
+            files.insert(normalize(app.icon_path));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_ = files;
+        for (const auto &file : files) {
+            std::string dir = std::filesystem::path(file).parent_path().string();
+            if (dir.empty()) {
+                dir = ".";
+            }
+            int wd = inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE);
+            if (wd >= 0) {
+                dirs_[wd] = dir;
+            }
+        }
+    }
+
+    bool take_changes(std::set<std::string> &changed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (changed_.empty()) {
+            return false;
+        }
+        changed.swap(changed_);
+        changed_.clear();
+        return true;
+    }
+
+    void stop() {
+        if (thread_.joinable()) {
+            char c = 0;
+            (void)!write(stop_pipe_[1], &c, 1);
+            thread_.join();
+        }
+        for (int *fd : {&fd_, &stop_pipe_[0], &stop_pipe_[1]}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    static std::string normalize(const std::string &path) {
+        return std::filesystem::path(path).lexically_normal().string();
+    }
+
+private:
+    void run() {
+        const int SETTLE_MS = 150;
+        std::set<std::string> batch;
+        while (true) {
+            struct pollfd fds[2] = {{fd_, POLLIN, 0}, {stop_pipe_[0], POLLIN, 0}};
+            // Block indefinitely, or only until the current burst settles.
+            int ready = poll(fds, 2, batch.empty() ? -1 : SETTLE_MS);
+            if (ready < 0 && errno != EINTR) {
+                break;
+            }
+            if (fds[1].revents) {
+                break;
+            }
+            if (ready == 0) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    changed_.insert(batch.begin(), batch.end());
+                }
+                batch.clear();
+                if (Uint32 type = wake_event.load()) {
+                    SDL_Event event = {};
+                    event.type = type;
+                    SDL_PushEvent(&event);
+                }
+                continue;
+            }
+            if (fds[0].revents & POLLIN) {
+                read_events(batch);
+            }
+        }
+    }
+
+    void read_events(std::set<std::string> &batch) {
+        alignas(struct inotify_event) char buf[4096];
+        ssize_t len;
+        while ((len = read(fd_, buf, sizeof(buf))) > 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (char* ptr = buf; ptr < buf + len; ) {
+                const struct inotify_event* ev = reinterpret_cast<const struct inotify_event*>(ptr);
+                ptr += sizeof(struct inotify_event) + ev->len;
+                auto dir = dirs_.find(ev->wd);
+                if (dir == dirs_.end() || ev->len == 0) {
+                    continue;
+                }
+                std::string path = normalize((std::filesystem::path(dir->second) / ev->name).string());
+                if (files_.count(path)) {
+                    batch.insert(path);
+                }
+            }
+        }
+    }
+
+    int fd_ = -1;
+    int stop_pipe_[2] = {-1, -1};
+    std::thread thread_;
+    std::mutex mutex_;
+    std::set<std::string> files_;
+    std::map<int, std::string> dirs_;
+    std::set<std::string> changed_;
 };
 
+// Move the resident items from old_apps over to apps, matching them by
+// name. Items with unchanged icons keep their atlas regions; the regions of removed
+// and changed items are freed for reuse, and the latter are loaded again
+// once they come into view.
+static void reload_resident_assets(ResidentAssets &res, const std::vector<App> &old_apps,
+                                   const std::vector<App> &apps, const std::set<std::string> &changed,
+                                   AssetLoader &loader) {
+    // Whatever the loader did not deliver yet refers to the old list.
+    cancel_requests(res, loader);
+    loader.start(apps, {}, false);
+    loader.set_layout(res.layout);
+    res.from_cache = false; // The baked cache no longer matches.
+    if (changed.count("bg.png")) {
+        res.background_pending = true;
+    }
+
+    std::map<std::string, std::deque<size_t>> old_by_name;
+    for (size_t j = 0; j < old_apps.size() && j < res.items.size(); ++j) {
+        old_by_name[old_apps[j].name].push_back(j);
+    }
+    std::vector<bool> reused(res.items.size(), false);
+    std::vector<ResidentAssets::Item> items(apps.size());
+    size_t kept = 0;
+    for (size_t i = 0; i < apps.size(); ++i) {
+        auto it = old_by_name.find(apps[i].name);
+        if (it == old_by_name.end() || it->second.empty()) {
+            continue;
+        }
+        size_t j = it->second.front();
+        it->second.pop_front();
+        if (res.items[j].loaded && old_apps[j].icon_path == apps[i].icon_path
+            && !changed.count(ConfigWatcher::normalize(apps[i].icon_path))) {
+            items[i] = std::move(res.items[j]);
+            reused[j] = true;
+            kept++;
+        }
+    }
+    for (size_t j = 0; j < res.items.size(); ++j) {
+        if (!reused[j]) {
+            release_item(res.atlas, res.items[j]);
+        }
+    }
+    res.items = std::move(items);
+
+    std::cout << "Launcher: Reloaded " << apps.size() << " items, kept " << kept << " resident"
+              << (changed.count("bg.png") ? "; reloading the background" : "") << std::endl;
+}
+
+
 // ===================================================================
 // Main Application
 // ===================================================================
 int main(int argc, char* argv[]) {
     std::filesystem::current_path(std::filesystem::path(argv[0]).parent_path());
 
+    Prefetcher prefetcher;
+    bool watch_config = true;
+    bool discover = false;
+    bool order_by_history = false;
+    RepeatConfig repeat_config;
+    LaunchHistory history;
+    ModePolicy mode_policy;
+    InputRecorder recorder;
+    InputReplay replay;
+    size_t gpu_budget_mb = 64;
     bool windowed = false;
+    bool bake = false;
+    int bake_w = 0, bake_h = 0;
     for (int i = 1; i < argc; ++i) {
         if (std::strcmp(argv[i], "--windowed") == 0) {
             windowed = true;
+        } else if (std::strcmp(argv[i], "--profile-startup") == 0) {
+            profiler.enabled = true;
+        } else if (std::strncmp(argv[i], "--profile-startup=", 18) == 0) {
+            profiler.enabled = true;
+            profiler.output_prefix = argv[i] + 18;
+        } else if (std::strcmp(argv[i], "--frame-stats") == 0) {
+            frame_stats.enabled = true;
+        } else if (std::strcmp(argv[i], "--hud") == 0) {
+            frame_stats.enabled = true;
+            frame_stats.hud = true;
+        } else if (std::strcmp(argv[i], "--no-prefetch") == 0) {
+            prefetcher.enabled = false;
+        } else if (std::strncmp(argv[i], "--prefetch-dwell=", 17) == 0) {
+            prefetcher.dwell_ms = std::atoi(argv[i] + 17);
+        } else if (std::strncmp(argv[i], "--record=", 9) == 0) {
+            if (!recorder.open(argv[i] + 9)) {
+                return 1;
+            }
+        } else if (std::strncmp(argv[i], "--replay=", 9) == 0) {
+            if (!replay.load(argv[i] + 9)) {
+                return 1;
+            }
+        } else if (std::strncmp(argv[i], "--mode=", 7) == 0) {
+            if (!parse_mode_policy(argv[i] + 7, mode_policy)) {
+                std::cerr << "Error: Expected --mode=max, --mode=current or --mode=WIDTHxHEIGHT[@HZ]" << std::endl;
+                return 1;
+            }
+        } else if (std::strncmp(argv[i], "--refresh=", 10) == 0) {
+            mode_policy.refresh = std::atof(argv[i] + 10);
+        } else if (std::strncmp(argv[i], "--render-height=", 16) == 0) {
+            mode_policy.render_height = std::atoi(argv[i] + 16);
+        } else if (std::strncmp(argv[i], "--gpu-budget=", 13) == 0) {
+            gpu_budget_mb = std::max(1, std::atoi(argv[i] + 13));
+        } else if (std::strcmp(argv[i], "--no-watch") == 0) {
+            watch_config = false;
+        } else if (std::strcmp(argv[i], "--discover") == 0) {
+            discover = true;
+        } else if (std::strcmp(argv[i], "--order=history") == 0) {
+            order_by_history = true;
+        } else if (std::strcmp(argv[i], "--order=config") == 0) {
+            order_by_history = false;
+        } else if (std::strncmp(argv[i], "--repeat=", 9) == 0) {
+            RepeatConfig &rc = repeat_config;
+            if (std::sscanf(argv[i] + 9, "%d,%d,%f,%d", &rc.delay_ms, &rc.interval_ms, &rc.accel, &rc.min_interval_ms) < 2
+                || rc.delay_ms < 0 || rc.interval_ms <= 0 || rc.accel <= 0.0f || rc.accel > 1.0f || rc.min_interval_ms <= 0) {
+                std::cerr << "Error: Expected --repeat=DELAY_MS,INTERVAL_MS[,ACCEL[,MIN_INTERVAL_MS]]" << std::endl;
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--no-repeat") == 0) {
+            repeat_config.enabled = false;
+        } else if (std::strncmp(argv[i], "--deadzone=", 11) == 0) {
+            repeat_config.deadzone = std::clamp(std::atoi(argv[i] + 11), 0, 32000);
+        } else if (std::strcmp(argv[i], "--report") == 0) {
+            history.load();
+            return history.report(std::cout);
+        } else if (std::strcmp(argv[i], "--bake") == 0) {
+            bake = true;
+        } else if (std::strncmp(argv[i], "--bake=", 7) == 0) {
+            bake = true;
+            if (std::sscanf(argv[i] + 7, "%dx%d", &bake_w, &bake_h) != 2 || bake_w <= 0 || bake_h <= 0) {
+                std::cerr << "Error: Expected --bake=WIDTHxHEIGHT" << std::endl;
+                return 1;
+            }
         }
     }
 
+    if (replay.active()) {
+        // Headless and deterministic: no display, GPU, prefetching or
+        // config watching needed.
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen,dummy");
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+        windowed = true;
+        frame_stats.enabled = true;
+        prefetcher.enabled = false;
+        watch_config = false;
+    }
+
     // Load env.conf
     {
-        std::ifstream conf("env.conf");
-        if (conf.is_open()) {
-            std::string line;
-            while (!conf.eof()) {
-                std::getline(conf, line);
-                if (line.empty() || conf.eof() || conf.bad()) {
-                    continue;
-                }
-                size_t pos = line.find("=");
-                std::string key = line.substr(0, pos);
-                std::string val = line.substr(pos + 1);
-                std::cout << "Set env var '" << key << "' to '" << val.c_str() << "'\n";
-                int ret = setenv(key.c_str(), val.c_str(), true);
-                if (ret) {
-                    std::cout << "  => failed: " << ret << std::endl;
-                }
-            }
-        } else {
-            std::cout << "No env.conf file found.\n";
-        }
+        ProfileScope scope("env.conf load");
+        load_env_conf();
     }
 
     // Load the config file.
     std::vector<App> apps;
     {
-        std::ifstream conf("apps.conf");
-        if (!conf.is_open()) {
+        ProfileScope scope("apps.conf parse");
+        if (!load_apps_conf(apps) && !discover) {
             std::cout << "No apps.conf file found. This is necessary. Will exit.\n";
             return 1;
         }
-        std::string line;
-        while (!conf.eof()) {
-            App app;
-            std::getline(conf, app.name);
-            std::getline(conf, app.icon_path);
+    }
+    if (discover) {
+        ProfileScope scope("application discovery");
+        discover_apps(apps);
+        if (apps.empty()) {
+            std::cout << "No apps.conf file and no applications found. Will exit.\n";
+            return 1;
+        }
+    }
+    if (order_by_history) {
+        ProfileScope scope("launch history");
+        history.load();
+        history.order(apps);
+    }
+    SearchIndex search_index;
+    {
+        ProfileScope scope("search index build");
+        search_index.build(apps);
+    }
 
-            if (conf.eof()) {
-                break;
-            }
-            std::cout << "Parse program '" << app.name << "' with icon: " << app.icon_path << std::endl;
-            while (true) {
-                std::getline(conf, line);
-                if (line.empty() || conf.eof() || conf.bad()) {
-                    // Seperator, new app!
-                    apps.emplace_back(std::move(app));
-                    break;
-                } else {
-                    // Variant name
-                    App::Variant v;
-                    v.variant_name = line;
-                    std::getline(conf, v.command);
-                    std::cout << "   Parse variant '" << v.variant_name << "' with command: " << v.command << std::endl;
-                    app.variants.emplace_back(std::move(v));
-                }
+    // SDL_ttf and the decoded assets stay alive for the whole process. Only the
+    // video and gamepad subsystems are brought up and down around each launch,
+    // as those are what hold on to the display.
+    Uint64 t_phase = Profiler::now_ns();
+    if (!TTF_Init()) {
+        std::cerr << "Error: Could not initialize SDL_ttf: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    profiler.add("TTF_Init", t_phase);
+    if (bake && bake_w > 0) {
+        // No display needed when the resolution is given explicitly.
+        bool ok = bake_asset_cache(apps, compute_layout(bake_w, bake_h));
+        TTF_Quit();
+        return ok ? 0 : 1;
+    }
+
+    // Start decoding icons while SDL and the display are being set up,
+    // unless a baked cache is likely going to make that unnecessary or
+    // --bake is about to render everything itself.
+    AssetLoader loader;
+    {
+        AssetCache cache;
+        if (!bake && !open_asset_cache(cache, apps, nullptr)) {
+            std::vector<int> first;
+            for (size_t i = 0; i < std::min(apps.size(), PRESTART_ITEMS); ++i) {
+                first.push_back(int(i));
             }
+            loader.start(apps, first, true);
         }
+        cache.close();
+    }
+
+    // Pick up edits to the configuration, background and icons while running.
+    ConfigWatcher watcher;
+    if (watch_config && watcher.start()) {
+        watcher.watch(apps);
     }
 
+    ResidentAssets resident;
+    TextEngine text_engine;
+    TextureManager textures;
+    textures.budget = gpu_budget_mb << 20;
+    Uint64 returned_at_ns = 0; // When the last launched app exited.
+    LaunchRecord last_launch = {};
+    Sint64 last_launch_offset = -1; // In launches.log, until menu_ms is known.
+
+    const Uint64 run_start_ns = SDL_GetTicksNS();
+    Uint64 total_frames = 0;
     bool loop = true;
     while (loop) {
         // 1. Initialize SDL and its subsystems
+        const Uint64 t_pass = Profiler::now_ns();
+        t_phase = t_pass;
         if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD)) {
             std::cerr << "Error: Could not initialize SDL: " << SDL_GetError() << std::endl;
             return 1;
         }
-
-        if (!TTF_Init()) {
-            std::cerr << "Error: Could not initialize SDL_ttf: " << SDL_GetError() << std::endl;
-            SDL_Quit();
-            return 1;
+        profiler.add("SDL_Init", t_phase);
+        if (!loader.wake_event) {
+            loader.wake_event = SDL_RegisterEvents(1);
+            watcher.wake_event = loader.wake_event.load();
         }
 
         // 2. Create a Fullscreen Window and Renderer
+        t_phase = Profiler::now_ns();
         SDL_Window* window = SDL_CreateWindow("Launcher", 0, 0, SDL_WINDOW_FULLSCREEN);
         if (!window) {
             std::cerr << "Error: Could not create window: " << SDL_GetError() << std::endl;
             // Cleanup...
             return 1;
         }
+        profiler.add("window creation", t_phase);
 
+        t_phase = Profiler::now_ns();
         if (!windowed) {
-            SDL_DisplayID display = SDL_GetDisplayForWindow(window);
-            int num_modes;
-            SDL_DisplayMode **modes = SDL_GetFullscreenDisplayModes(display, &num_modes);
-            for (int i = 0; i < num_modes; ++i) {
-                SDL_DisplayMode *m = modes[i];
-                std::cout << "Mode: " << m->w << "x" << m->h << "@" << m->refresh_rate << std::endl;
-            }
-            if (num_modes > 0) {
-                SDL_SetWindowFullscreenMode(window, modes[0]);
-                SDL_SyncWindow(window);
-            }
+            apply_mode_policy(window, mode_policy);
             SDL_HideCursor();
         }
+        profiler.add("fullscreen mode set", t_phase);
 
 
+        t_phase = Profiler::now_ns();
         SDL_Renderer* renderer = SDL_CreateRenderer(window, NULL);
         if (!renderer) {
             std::cerr << "Error: Could not create renderer: " << SDL_GetError() << std::endl;
             // Cleanup...
             return 1;
         }
+        if (!SDL_SetRenderVSync(renderer, 1)) {
+            std::cerr << "Warning: Could not enable vsync: " << SDL_GetError() << std::endl;
+        }
+        profiler.add("renderer creation", t_phase);
+        textures.renderer = renderer;
 
         int screen_w, screen_h;
         SDL_GetRenderOutputSize(renderer, &screen_w, &screen_h);
 
+        // Render below the output resolution if asked to; everything is
+        // laid out for the render size and scaled up at present.
+        Texture render_target;
+        if (mode_policy.render_height > 0 && mode_policy.render_height < screen_h) {
+            const int render_w = screen_w * mode_policy.render_height / screen_h;
+            const int render_h = mode_policy.render_height;
+            render_target = textures.create("render target", render_w, render_h, SDL_TEXTUREACCESS_TARGET);
+            if (render_target) {
+                SDL_SetTextureScaleMode(render_target.get(), SDL_SCALEMODE_LINEAR);
+                std::cout << "Rendering at " << render_w << "x" << render_h << " for "
+                          << screen_w << "x" << screen_h << std::endl;
+                screen_w = render_w;
+                screen_h = render_h;
+            }
+        }
 
-        // 3. Load Font
-        TTF_Font* font = nullptr;
-        const std::vector<const char*> font_paths = {
-#if __APPLE__
-            "/System/Library/Fonts/Geneva.ttf",
-            "/System/Library/Fonts/NewYork.ttf"
-#else
-            "/usr/share/fonts/dejavu-sans-fonts/DejaVuSans.ttf",
-            "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
-            "/usr/share/fonts/liberation/LiberationSans-Regular.ttf",
-            "/usr/share/fonts/corefonts/arial.ttf", // Common on some systems
-            "/usr/share/fonts/TTF/DejaVuSans.ttf" // Fallback path
-#endif
-        };
 
         // --- Layout constants ---
-        const int ICON_BASE_SIZE = screen_h / 8;
-        const int ICON_SPACING = screen_h / 12;
-        const float SELECTED_SCALE = 1.3f;
-        const int TEXT_Y_OFFSET = screen_h / 30;
-        const int FONT_SIZE = screen_h / 40;
-
-        for (const auto& path : font_paths) {
-            font = TTF_OpenFont(path, FONT_SIZE);
-            if (font) {
-                std::cout << "Loaded font: " << path << std::endl;
-                break;
-            }
-        }
+        const Layout layout = compute_layout(screen_w, screen_h);
+        const int ICON_BASE_SIZE = layout.icon_base_size;
+        const int ICON_SPACING = layout.icon_spacing;
+        const float SELECTED_SCALE = layout.selected_scale;
+        const int TEXT_Y_OFFSET = layout.text_y_offset;
+        const int FONT_SIZE = layout.font_size;
 
-        if (!font) {
-            std::cerr << "Error: Could not load any system font: " << SDL_GetError() << std::endl;
-            // Cleanup...
-            return 1;
+        if (bake) {
+            // Bake for the resolution the launcher actually ends up with.
+            loader.stop();
+            bool ok = bake_asset_cache(apps, layout);
+            render_target.reset();
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            TTF_Quit();
+            SDL_Quit();
+            return ok ? 0 : 1;
         }
 
-        // 4. Load Resources (Icons and Text Textures)
-        std::vector<MenuItem> menu_items;
-        menu_items.reserve(apps.size());
-        SDL_Color text_color = {255, 255, 255, 255}; // White
-        SDL_Texture *background = IMG_LoadTexture(renderer, "bg.png");
-        SDL_SetTextureScaleMode(background, SDL_SCALEMODE_LINEAR);
-        TTF_SetFontWrapAlignment(font, TTF_HORIZONTAL_ALIGN_CENTER);
-
-        for (const auto& app : apps) {
-            MenuItem item;
-            item.name = app.name;
-
-            // Load Icon
-            item.icon_texture = IMG_LoadTexture(renderer, app.icon_path.c_str());
-            if (!item.icon_texture) {
-                std::cerr << "Warning: Could not load icon " << app.icon_path << ": " << SDL_GetError() << std::endl;
-            }
-
-            // Create Text Texture
-            SDL_Surface* text_surface = TTF_RenderText_Blended_Wrapped(
-                    font, app.name.c_str(), app.name.length(),
-                    text_color, int(ICON_BASE_SIZE * 1.2)
-            );
-            if (text_surface) {
-                item.text_texture = SDL_CreateTextureFromSurface(renderer, text_surface);
-                item.text_width = text_surface->w;
-                item.text_height = text_surface->h;
-                SDL_DestroySurface(text_surface);
-            } else {
-                 std::cerr << "Warning: Could not render text for " << app.name << ": " << SDL_GetError() << std::endl;
-            }
+        // 3. Load Font, Icons and Text (no-op when returning from an app)
+        const int ATLAS_PAGE_SIZE = static_cast<int>(std::min<Sint64>(2048,
+                SDL_GetNumberProperty(SDL_GetRendererProperties(renderer),
+                                      SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 2048)));
+        // The atlas gets what the budget leaves after the render target and
+        // the screen-sized background and static layer.
+        const size_t screen_bytes = size_t(screen_w) * screen_h * 4;
+        const size_t reserved_bytes = textures.resident() + 2 * screen_bytes;
+        resident.gpu_budget = textures.budget > reserved_bytes ? textures.budget - reserved_bytes : 0;
+        prepare_resident_assets(resident, apps, layout, ATLAS_PAGE_SIZE, loader);
+        t_phase = Profiler::now_ns();
+        text_engine.create(renderer, layout);
+        TTF_Text* hud_text = frame_stats.hud ? text_engine.create_text("") : nullptr;
+        profiler.add("text engine", t_phase);
 
-            for (size_t vi = 0; vi < app.variants.size(); ++vi) {
-                const std::string &vname = app.variants[vi].variant_name;
-                MenuItem::Variant v;
-                SDL_Surface* text_surface = TTF_RenderText_Blended(
-                        font, vname.c_str(), vname.length(), text_color
-                );
-                v.text_texture = SDL_CreateTextureFromSurface(renderer, text_surface);
-                v.text_width = text_surface->w;
-                v.text_height = text_surface->h;
-                item.variants.push_back(v);
+        // 4. Upload Resources (Atlas pages and background). Items still being
+        // loaded are packed and uploaded from the main loop as they finish.
+        t_phase = Profiler::now_ns();
+        resident.atlas.upload(textures);
+        Texture background;
+        const SDL_Surface *background_source = nullptr;
+        auto upload_background = [&]() {
+            if (background && resident.background == background_source) {
+                return;
             }
+            background.reset();
+            background_source = resident.background;
+            background = textures.upload("background", resident.background);
+            if (background) {
+                SDL_SetTextureScaleMode(background.get(), SDL_SCALEMODE_LINEAR);
+            }
+        };
+        upload_background();
 
-            menu_items.push_back(std::move(item));
-        }
+        std::vector<MenuItem> menu_items;
+        auto build_menu_items = [&]() {
+            free_menu_labels(menu_items);
+            menu_items.clear();
+            menu_items.reserve(apps.size());
+            for (const auto &app : apps) {
+                MenuItem item;
+                item.name = app.name;
+                item.num_variants = int(app.variants.size());
+                item.selected_variant = order_by_history ? history.last_variant(app) : 0;
+                menu_items.push_back(std::move(item));
+            }
+        };
+        build_menu_items();
+        QuadBatch batch;
+        profiler.add("texture upload", t_phase);
 
 
         // --- Gamepad Setup ---
+        t_phase = Profiler::now_ns();
         std::vector<SDL_Gamepad*> gamepads;
         int num_joysticks = 0;
         SDL_JoystickID* joysticks = SDL_GetJoysticks(&num_joysticks);
@@ -272,6 +3956,7 @@ int main(int argc, char* argv[]) {
             }
             SDL_free(joysticks);
         }
+        profiler.add("gamepad enumeration", t_phase);
 
 
         // 5. Main Loop
@@ -281,27 +3966,200 @@ int main(int argc, char* argv[]) {
         SDL_Event event;
         float scroll_accum = 0.0f;
 
+        // Search: the row shows the apps in shown, which is either all of
+        // them or the result for query. results[n] is the result for the
+        // first n characters, so typing only filters the previous result and
+        // backspace doesn't have to filter at all.
+        bool searching = false;
+        std::string query;
+        std::vector<std::vector<int>> results;
+        std::vector<int> shown = search_index.all();
+        int selected_pos = 0; // Position of selected_app_index in shown.
+        auto show = [&](const std::vector<int> &list) {
+            // Stay on the selected app if it is still there, otherwise on
+            // the one that took its place.
+            auto it = std::lower_bound(list.begin(), list.end(), selected_app_index);
+            selected_pos = list.empty() ? 0 : std::min<int>(it - list.begin(), list.size() - 1);
+            if (!list.empty()) {
+                selected_app_index = list[selected_pos];
+            }
+            shown = list;
+        };
+        auto set_query = [&](const std::string &new_query) {
+            while (results.size() > new_query.size() + 1 ||
+                   (!results.empty() && query.compare(0, results.size() - 1, new_query, 0, results.size() - 1) != 0)) {
+                results.pop_back();
+            }
+            if (results.empty()) {
+                results.push_back(search_index.all());
+            }
+            query = new_query;
+            Uint64 t_filter = SDL_GetTicksNS();
+            while (results.size() <= query.size()) {
+                results.push_back(search_index.filter(query.substr(0, results.size()), results.back()));
+            }
+            if (frame_stats.enabled) {
+                std::cout << "Launcher: Search '" << query << "': " << results.back().size() << " of "
+                          << apps.size() << " in " << (SDL_GetTicksNS() - t_filter) / 1000 << " us" << std::endl;
+            }
+            show(results.back());
+        };
+
+        // The on-screen keyboard for searching with a gamepad. KMSDRM has no
+        // system screen keyboard, so it is a row of characters of our own.
+        const std::string OSK_CHARS = "abcdefghijklmnopqrstuvwxyz0123456789 ";
+        bool osk_open = false;
+        int osk_cursor = 0;
+        std::vector<TTF_Text*> osk_texts;
+        TTF_Text* search_text = nullptr;
 
-        // Calculate total width for centering
-        const int total_width = (apps.size() * ICON_BASE_SIZE) + ((apps.size() - 1) * ICON_SPACING);
-        const int start_x = (screen_w - total_width) / 2;
+        // The carousel: all shown items on one row, centered when they fit
+        // on screen, otherwise scrolled to keep the selection centered.
+        const int ITEM_STEP = ICON_BASE_SIZE + ICON_SPACING;
+        auto row_start_x = [&]() {
+            int total_width = int(shown.size()) * ITEM_STEP - ICON_SPACING;
+            if (total_width <= screen_w) {
+                return (screen_w - total_width) / 2;
+            }
+            int centered = (screen_w - ICON_BASE_SIZE) / 2 - selected_pos * ITEM_STEP;
+            return std::clamp(centered, screen_w - total_width, 0);
+        };
 
         SDL_SetWindowKeyboardGrab(window, true);
 
+        // Redraw scheduling: the scene only changes in response to input, so
+        // when nothing is dirty we block in SDL_WaitEventTimeout instead of
+        // spinning. Skipped frames are counted in display refresh intervals
+        // that a continuously presenting loop would have rendered.
+        const int IDLE_WAIT_MS = 1000;
+        bool dirty = true;
+        Uint64 frames_rendered = 0;
+        Uint64 frames_skipped = 0;
+        Uint64 frame_period_ns = 1000000000ull / 60;
+        {
+            const SDL_DisplayMode *mode = SDL_GetCurrentDisplayMode(SDL_GetDisplayForWindow(window));
+            if (mode && mode->refresh_rate > 0.0f) {
+                frame_period_ns = Uint64(1e9 / mode->refresh_rate);
+            }
+        }
+        Uint64 last_present_ns = SDL_GetTicksNS();
+        Uint64 pending_input_ns = 0; // Oldest input not yet reflected on screen.
+        const App::Variant* prefetch_target = nullptr;
+
+        Texture static_layer;
+        bool static_layer_failed = false;
+        bool static_layer_dirty = true;
+        int static_layer_selected = -1;
+        int static_layer_start_x = 0;
+        Uint64 static_layer_updates = 0;
+
+        InputRepeat input_repeat(repeat_config);
         struct {
-            bool up;
-            bool down;
-            bool left;
-            bool right;
+            int up; // Steps in each direction
+            int down;
+            int left;
+            int right;
+            bool repeated; // Some of them from holding
             bool confirm;
             bool cancel;
+            bool search;
+            bool erase;
+            bool keyboard;
+            int keyboard_move;
         } controls;
+        std::string typed;
 
+        const Uint64 menu_start_ns = SDL_GetTicksNS(); // Time base for --record and --replay.
         while (running) {
             // --- Event Handling ---
             std::memset(&controls, 0, sizeof(controls));
-            SDL_PumpEvents();
-            while (SDL_PollEvent(&event)) {
+            typed.clear();
+            std::set<std::string> changed;
+            if (watcher.take_changes(changed)) {
+                std::cout << "Launcher: Changed:";
+                for (const auto &file : changed) {
+                    std::cout << " " << file;
+                }
+                std::cout << std::endl;
+                if (changed.count("env.conf")) {
+                    load_env_conf();
+                }
+                std::vector<App> new_apps = apps;
+                if (changed.count("apps.conf")) {
+                    bool loaded = load_apps_conf(new_apps);
+                    if (discover) {
+                        discover_apps(new_apps);
+                    }
+                    if (order_by_history) {
+                        history.order(new_apps);
+                    }
+                    if ((!loaded && !discover) || new_apps.empty()) {
+                        std::cerr << "Warning: apps.conf unreadable or empty; keeping the current apps." << std::endl;
+                        new_apps = apps;
+                    }
+                }
+                reload_resident_assets(resident, apps, new_apps, changed, loader);
+
+                // Rebuild the menu, keeping the selection where the app still exists.
+                std::map<std::string, int> selected_variants;
+                for (const auto &mi : menu_items) {
+                    selected_variants.emplace(mi.name, mi.selected_variant);
+                }
+                std::string selected_name = selected_app_index < menu_items.size() ? menu_items[selected_app_index].name : "";
+                apps = std::move(new_apps);
+                build_menu_items();
+                selected_app_index = std::min<int>(selected_app_index, menu_items.size() - 1);
+                for (size_t i = 0; i < menu_items.size(); ++i) {
+                    auto sv = selected_variants.find(menu_items[i].name);
+                    if (sv != selected_variants.end() && sv->second < menu_items[i].num_variants) {
+                        menu_items[i].selected_variant = sv->second;
+                    }
+                    if (menu_items[i].name == selected_name) {
+                        selected_app_index = int(i);
+                    }
+                }
+                search_index.build(apps);
+                results.clear();
+                set_query(query);
+                prefetch_target = nullptr; // Pointed into the old list.
+                watcher.watch(apps);
+                dirty = true;
+                static_layer_dirty = true;
+            }
+            if (take_loaded_assets(resident, loader) > 0) {
+                upload_background();
+                dirty = true;
+                static_layer_dirty = true;
+            }
+            int wait_ms = IDLE_WAIT_MS;
+            if (replay.active()) {
+                int next_ms = replay.pump(profiler.pass, SDL_GetTicksNS() - menu_start_ns);
+                if (next_ms >= 0) {
+                    wait_ms = std::min(wait_ms, next_ms);
+                }
+            }
+            const int repeat_ms = input_repeat.wait_ms(SDL_GetTicksNS());
+            if (repeat_ms >= 0) {
+                wait_ms = std::min(wait_ms, repeat_ms);
+            }
+            bool have_event = dirty ? SDL_PollEvent(&event) : SDL_WaitEventTimeout(&event, wait_ms);
+            for (; have_event; have_event = SDL_PollEvent(&event)) {
+                recorder.record(profiler.pass, event.common.timestamp > menu_start_ns
+                                ? event.common.timestamp - menu_start_ns : 0, event);
+                if (event.type == SDL_EVENT_WINDOW_EXPOSED) {
+                    dirty = true;
+                }
+                if (event.type == SDL_EVENT_RENDER_TARGETS_RESET ||
+                    event.type == SDL_EVENT_RENDER_DEVICE_RESET) {
+                    dirty = true;
+                    static_layer_dirty = true;
+                }
+                if (event.type == SDL_EVENT_KEY_DOWN || event.type == SDL_EVENT_MOUSE_WHEEL ||
+                    event.type == SDL_EVENT_MOUSE_BUTTON_DOWN || event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN) {
+                    if (!pending_input_ns || event.common.timestamp < pending_input_ns) {
+                        pending_input_ns = event.common.timestamp;
+                    }
+                }
                 if (event.type == SDL_EVENT_QUIT) {
                     selected_app_index = -1;
                     controls.cancel = true;
@@ -309,22 +4167,27 @@ int main(int argc, char* argv[]) {
                     loop = false;
                 }
                 if (event.type == SDL_EVENT_KEY_DOWN) {
-                    switch (event.key.key) {
+                    SDL_Keycode key = event.key.key;
+                    if (searching && (key == SDLK_H || key == SDLK_J || key == SDLK_K || key == SDLK_L)) {
+                        key = SDLK_UNKNOWN; // Typed into the query.
+                    }
+                    const Uint64 t = event.common.timestamp;
+                    switch (key) {
                         case SDLK_LEFT:
                         case SDLK_H:
-                            controls.left = true;
+                            input_repeat.press(InputRepeat::LEFT, key, t);
                             break;
                         case SDLK_RIGHT:
                         case SDLK_L:
-                            controls.right = true;
+                            input_repeat.press(InputRepeat::RIGHT, key, t);
                             break;
                         case SDLK_K:
                         case SDLK_UP:
-                            controls.up = true;
+                            input_repeat.press(InputRepeat::UP, key, t);
                             break;
                         case SDLK_DOWN:
                         case SDLK_J:
-                            controls.down = true;
+                            input_repeat.press(InputRepeat::DOWN, key, t);
                             break;
                         case SDLK_RETURN:
                         case SDLK_KP_ENTER:
@@ -333,15 +4196,27 @@ int main(int argc, char* argv[]) {
                         case SDLK_ESCAPE:
                             controls.cancel = true;
                             break;
+                        case SDLK_SLASH:
+                            controls.search = !searching;
+                            break;
+                        case SDLK_BACKSPACE:
+                            controls.erase = true;
+                            break;
                     }
                 }
+                if (event.type == SDL_EVENT_KEY_UP) {
+                    input_repeat.release(event.key.key);
+                }
+                if (event.type == SDL_EVENT_TEXT_INPUT && searching) {
+                    typed += event.text.text;
+                }
                 if (event.type == SDL_EVENT_MOUSE_WHEEL) {
                     scroll_accum += event.wheel.y;
                     if (scroll_accum < -0.5f) {
-                        controls.left = true;
+                        controls.left++;
                         scroll_accum = 0.0f;
                     } else if (scroll_accum > 0.5f) {
-                        controls.right = true;
+                        controls.right++;
                         scroll_accum = 0.0f;
                     }
                 } else if (event.type == SDL_EVENT_MOUSE_BUTTON_DOWN) {
@@ -349,7 +4224,7 @@ int main(int argc, char* argv[]) {
                         controls.confirm = true;
                     } else if (event.button.button == SDL_BUTTON_RIGHT) {
                         controls.cancel = true;
-                        loop = false;
+                        loop = loop && searching;
                     }
                 }
                 // --- Gamepad Hotplugging and Input ---
@@ -371,22 +4246,71 @@ int main(int argc, char* argv[]) {
                         }
                     }
                     SDL_CloseGamepad(pad_to_remove);
+                    input_repeat.release_all();
+                }
+                if (event.type == SDL_EVENT_GAMEPAD_BUTTON_UP) {
+                    input_repeat.release(InputRepeat::PAD | event.gbutton.button);
                 }
-                if (event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN) {
+                if (event.type == SDL_EVENT_GAMEPAD_AXIS_MOTION && replay.active()) {
+                    input_repeat.replay_stick(event.gaxis.axis, event.gaxis.value);
+                }
+                const Uint32 button = InputRepeat::PAD | event.gbutton.button;
+                if (event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN && osk_open) {
+                    // The d-pad moves over the on-screen keyboard, the
+                    // shoulder buttons over the items.
+                    const Uint64 t = event.common.timestamp;
+                    switch(event.gbutton.button) {
+                        case SDL_GAMEPAD_BUTTON_DPAD_LEFT:
+                            controls.keyboard_move = -1;
+                            break;
+                        case SDL_GAMEPAD_BUTTON_DPAD_RIGHT:
+                            controls.keyboard_move = 1;
+                            break;
+                        case SDL_GAMEPAD_BUTTON_LEFT_SHOULDER:
+                            input_repeat.press(InputRepeat::LEFT, button, t);
+                            break;
+                        case SDL_GAMEPAD_BUTTON_RIGHT_SHOULDER:
+                            input_repeat.press(InputRepeat::RIGHT, button, t);
+                            break;
+                        case SDL_GAMEPAD_BUTTON_DPAD_DOWN:
+                            input_repeat.press(InputRepeat::DOWN, button, t);
+                            break;
+                        case SDL_GAMEPAD_BUTTON_DPAD_UP:
+                            input_repeat.press(InputRepeat::UP, button, t);
+                            break;
+                        case SDL_GAMEPAD_BUTTON_SOUTH:
+                            typed += OSK_CHARS[osk_cursor];
+                            break;
+                        case SDL_GAMEPAD_BUTTON_EAST:
+                            if (query.empty()) {
+                                controls.cancel = true;
+                            } else {
+                                controls.erase = true;
+                            }
+                            break;
+                        case SDL_GAMEPAD_BUTTON_NORTH:
+                            controls.keyboard = true;
+                            break;
+                        case SDL_GAMEPAD_BUTTON_START:
+                            controls.confirm = true;
+                            break;
+                    }
+                } else if (event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN) {
+                    const Uint64 t = event.common.timestamp;
                     switch(event.gbutton.button) {
                         case SDL_GAMEPAD_BUTTON_DPAD_LEFT:
                         case SDL_GAMEPAD_BUTTON_LEFT_SHOULDER:
-                            controls.left = true;
+                            input_repeat.press(InputRepeat::LEFT, button, t);
                             break;
                         case SDL_GAMEPAD_BUTTON_DPAD_RIGHT:
                         case SDL_GAMEPAD_BUTTON_RIGHT_SHOULDER:
-                            controls.right = true;
+                            input_repeat.press(InputRepeat::RIGHT, button, t);
                             break;
                         case SDL_GAMEPAD_BUTTON_DPAD_DOWN:
-                            controls.down = true;
+                            input_repeat.press(InputRepeat::DOWN, button, t);
                             break;
                         case SDL_GAMEPAD_BUTTON_DPAD_UP:
-                            controls.up = true;
+                            input_repeat.press(InputRepeat::UP, button, t);
                             break;
                         case SDL_GAMEPAD_BUTTON_SOUTH: // A button on Xbox/Switch Pro, X on PS
                             controls.confirm = true;
@@ -394,142 +4318,409 @@ int main(int argc, char* argv[]) {
                         case SDL_GAMEPAD_BUTTON_EAST: // B button on Xbox, Circle on PS
                             controls.cancel = true;
                             break;
+                        case SDL_GAMEPAD_BUTTON_NORTH: // Y button on Xbox, Triangle on PS
+                            controls.keyboard = true;
+                            break;
+                    }
+                }
+            }
+
+            // Presses and repeats of the navigation, on the repeat clock.
+            {
+                const Uint64 now_ns = SDL_GetTicksNS();
+                input_repeat.sample_sticks(gamepads, now_ns);
+                InputRepeat::Steps steps = input_repeat.poll(now_ns);
+                controls.left += steps.count[InputRepeat::LEFT];
+                controls.right += steps.count[InputRepeat::RIGHT];
+                controls.up += steps.count[InputRepeat::UP];
+                controls.down += steps.count[InputRepeat::DOWN];
+                controls.repeated = steps.repeated;
+                if (steps.first_ns && (!pending_input_ns || steps.first_ns < pending_input_ns)) {
+                    pending_input_ns = steps.first_ns;
+                }
+            }
+
+            // --- Search ---
+            if ((controls.search || controls.keyboard) && !searching) {
+                searching = true;
+                SDL_StartTextInput(window);
+                dirty = true;
+            }
+            if (controls.keyboard) {
+                osk_open = !osk_open;
+                dirty = true;
+            }
+            if (controls.keyboard_move) {
+                osk_cursor = (osk_cursor + controls.keyboard_move + int(OSK_CHARS.size())) % int(OSK_CHARS.size());
+                dirty = true;
+            }
+            if (searching && running && controls.cancel) {
+                // Leave the search rather than the launcher.
+                controls.cancel = false;
+                searching = false;
+                osk_open = false;
+                SDL_StopTextInput(window);
+                typed.clear();
+                set_query("");
+                dirty = true;
+                static_layer_dirty = true;
+            }
+            if (searching && (controls.erase || !typed.empty())) {
+                std::string new_query = query;
+                if (controls.erase) {
+                    while (!new_query.empty() && (Uint8(new_query.back()) & 0xC0) == 0x80) {
+                        new_query.pop_back(); // UTF-8 continuation bytes.
+                    }
+                    if (!new_query.empty()) {
+                        new_query.pop_back();
                     }
                 }
+                set_query(new_query + typed);
+                dirty = true;
+                static_layer_dirty = true;
             }
 
             if (controls.cancel) {
                 selected_app_index = -1; // Special value for escape
                 running = false;
-            } else if (controls.left) {
-                selected_app_index = (selected_app_index - 1 + apps.size()) % apps.size();
-            } else if (controls.right) {
-                selected_app_index = (selected_app_index + 1) % apps.size();
+            } else if (shown.empty()) {
+                // Nothing matches the search; nothing to move to or launch.
+            } else if (controls.left != controls.right) {
+                // Presses wrap around at the ends, holding stops there.
+                const int n = int(shown.size());
+                const int pos = selected_pos + controls.right - controls.left;
+                const int new_pos = controls.repeated ? std::clamp(pos, 0, n - 1) : (pos % n + n) % n;
+                if (new_pos != selected_pos) {
+                    selected_pos = new_pos;
+                    selected_app_index = shown[selected_pos];
+                    dirty = true;
+                }
             } else if (controls.confirm) {
                 running = false;
             }
-            if (selected_app_index >= 0 && selected_app_index < menu_items.size()) {
+            if (!shown.empty() && selected_app_index >= 0 && selected_app_index < menu_items.size()) {
                 auto &sv = menu_items[selected_app_index].selected_variant;
-                int vc = menu_items[selected_app_index].variants.size();
-                if (controls.up) {
-                    sv = (sv - 1 + vc) % vc;
-                } else if (controls.down) {
-                    sv = (sv + 1) % vc;
+                int vc = menu_items[selected_app_index].num_variants;
+                if (controls.up != controls.down) {
+                    // Same as the row: only presses wrap.
+                    const int v = sv + controls.down - controls.up;
+                    const int new_sv = controls.repeated ? std::clamp(v, 0, vc - 1) : (v % vc + vc) % vc;
+                    if (new_sv != sv) {
+                        sv = new_sv;
+                        dirty = true;
+                    }
+                }
+            }
+
+            // Warm up the page cache for whatever the selection rests on,
+            // and keep at it through the teardown when that gets launched.
+            const App::Variant* hovered = nullptr;
+            if (!shown.empty() && selected_app_index >= 0 && selected_app_index < apps.size()) {
+                const App &app = apps[selected_app_index];
+                int sv = menu_items[selected_app_index].selected_variant;
+                if (sv >= 0 && sv < app.variants.size()) {
+                    hovered = &app.variants[sv];
                 }
             }
+            if (hovered != prefetch_target) {
+                prefetch_target = hovered;
+                prefetcher.hover(hovered);
+            }
+            if (!running && hovered) {
+                prefetcher.hurry();
+            }
+
+            if (!dirty || !running) {
+                pending_input_ns = 0; // Input without visible effect.
+                continue;
+            }
+            dirty = false;
+
+            // Only items on screen are drawn (and pinned in the atlas); one
+            // screen worth of items on either side is loaded ahead. These
+            // are positions in shown.
+            const int start_x = row_start_x();
+            const int first_visible = std::max(0, -start_x / ITEM_STEP - 1);
+            const int last_visible = std::min(int(shown.size()) - 1, (screen_w - start_x) / ITEM_STEP);
+            const int per_screen = last_visible - first_visible + 1;
+            if (!shown.empty() && request_items(resident, loader, shown, first_visible, last_visible,
+                                                std::max(0, first_visible - per_screen), last_visible + per_screen)) {
+                static_layer_dirty = true;
+            }
+
+            if (frames_rendered == 0 && !shown.empty() && loader.busy() &&
+                !resident.items[selected_app_index].loaded) {
+                // Hold the first present until there is something to show;
+                // the loader wakes us up when items arrive.
+                continue;
+            }
 
             // --- Drawing ---
-            SDL_SetRenderDrawColor(renderer, 20, 20, 35, 255); // Dark blue background
-            SDL_RenderClear(renderer);
-            SDL_FRect fullscreen_rect { 0, 0, float(screen_w), float(screen_h) };
-            SDL_RenderTexture(renderer, background, NULL, &fullscreen_rect);
-
-            int current_x = start_x;
-            for (int i = 0; i < menu_items.size(); ++i) {
-                MenuItem &mi = menu_items[i];
-                float scale = (i == selected_app_index) ? SELECTED_SCALE : 1.0f;
-                int icon_size = static_cast<int>(ICON_BASE_SIZE * scale);
-
-                // Center the icon vertically
-                SDL_FRect icon_rect = {
-                    static_cast<float>(current_x + (ICON_BASE_SIZE / 2) - (icon_size / 2)),
-                    static_cast<float>((screen_h / 2) - (icon_size / 2)),
-                    static_cast<float>(icon_size),
-                    static_cast<float>(icon_size)
-                };
-
-                // Dim non-selected items
-                Uint8 brightness = (i == selected_app_index) ? 255 : 150;
-                SDL_SetTextureColorMod(mi.icon_texture, brightness, brightness, brightness);
-                SDL_SetTextureColorMod(mi.text_texture, brightness, brightness, brightness);
-
-                // Render Icon
-                if (mi.icon_texture) {
-                    SDL_RenderTexture(renderer, mi.icon_texture, NULL, &icon_rect);
-                }
-
-                // Render Text below the icon
-                if (mi.text_texture) {
-                    float text_x = current_x + (ICON_BASE_SIZE / 2) - (mi.text_width / 2);
-                    SDL_FRect text_rect = {
-                        text_x,
-                        static_cast<float>((screen_h + ICON_BASE_SIZE) / 2 + TEXT_Y_OFFSET),
-                        static_cast<float>(mi.text_width),
-                        static_cast<float>(mi.text_height)
+            const Uint64 frame_start_ns = SDL_GetTicksNS();
+
+            // Icons and names of the visible items: either all but the
+            // selected one (static layer) or only the selected one.
+            auto draw_items = [&](bool selected) {
+                batch.clear();
+                for (int k = first_visible; k <= last_visible; ++k) {
+                    if ((k == selected_pos) != selected) {
+                        continue;
+                    }
+                    const int i = shown[k];
+                    int current_x = start_x + k * ITEM_STEP;
+                    float scale = selected ? SELECTED_SCALE : 1.0f;
+                    int icon_size = static_cast<int>(ICON_BASE_SIZE * scale);
+
+                    // Center the icon vertically
+                    SDL_FRect icon_rect = {
+                        static_cast<float>(current_x + (ICON_BASE_SIZE / 2) - (icon_size / 2)),
+                        static_cast<float>((screen_h / 2) - (icon_size / 2)),
+                        static_cast<float>(icon_size),
+                        static_cast<float>(icon_size)
                     };
-                    SDL_RenderTexture(renderer, mi.text_texture, NULL, &text_rect);
+
+                    // Dim non-selected items
+                    batch.add(resident.atlas, resident.items[i].icon, icon_rect, selected ? 255 : 150);
+                }
+                batch.draw(renderer, resident.atlas);
+
+                for (int k = first_visible; k <= last_visible; ++k) {
+                    if ((k == selected_pos) != selected) {
+                        continue;
+                    }
+                    // Text below the icon
+                    const int i = shown[k];
+                    MenuItem &mi = menu_items[i];
+                    if (!mi.label) {
+                        mi.label = text_engine.create_text(apps[i].name, layout.wrap_width);
+                    }
+                    SDL_Point size = TextEngine::size(mi.label);
+                    float text_x = start_x + k * ITEM_STEP + (ICON_BASE_SIZE / 2) - (size.x / 2);
+                    float text_y = (screen_h + ICON_BASE_SIZE) / 2 + TEXT_Y_OFFSET;
+                    TextEngine::draw(mi.label, text_x, text_y, selected ? 255 : 150);
                 }
+            };
+            auto draw_static_layer = [&]() {
+                SDL_SetRenderDrawColor(renderer, 20, 20, 35, 255); // Dark blue background
+                SDL_RenderClear(renderer);
+                SDL_FRect fullscreen_rect { 0, 0, float(screen_w), float(screen_h) };
+                SDL_RenderTexture(renderer, background.get(), NULL, &fullscreen_rect);
+                draw_items(false);
+            };
 
-                current_x += ICON_BASE_SIZE + ICON_SPACING;
+            // The background and the unselected items only change with the
+            // selection, scrolling or loading, so they are composited into
+            // a texture once and only that is drawn on other frames. It is
+            // the first thing to go when the GPU budget is tight.
+            if (!static_layer && !static_layer_failed) {
+                static_layer = textures.create("static layer", screen_w, screen_h, SDL_TEXTUREACCESS_TARGET, true);
+                if (static_layer) {
+                    SDL_SetTextureBlendMode(static_layer.get(), SDL_BLENDMODE_NONE);
+                } else {
+                    static_layer_failed = true;
+                }
+                static_layer_dirty = true;
             }
+            if (static_layer && (static_layer_dirty || static_layer_selected != selected_pos
+                                 || static_layer_start_x != start_x)) {
+                SDL_SetRenderTarget(renderer, static_layer.get());
+                draw_static_layer();
+                static_layer_dirty = false;
+                static_layer_selected = selected_pos;
+                static_layer_start_x = start_x;
+                static_layer_updates++;
+            }
+            SDL_SetRenderTarget(renderer, render_target.get());
+            if (static_layer) {
+                SDL_RenderTexture(renderer, static_layer.get(), NULL, NULL);
+            } else {
+                draw_static_layer();
+            }
+            draw_items(true);
 
-            if (selected_app_index != -1) {
-                // Render variants name of the selected app
+            if (!shown.empty()) {
+                // Variants names of the selected app
                 MenuItem &mi = menu_items[selected_app_index];
-                for (int vi = 0; vi < mi.variants.size(); ++vi) {
-                    auto &v = mi.variants[vi];
-                    if (v.text_texture) {
-                        float text_x = (screen_w - v.text_width) / 2;
-                        float y = screen_h * 3 / 4 + (vi - mi.selected_variant) * FONT_SIZE * 3 / 2;
-                        SDL_FRect text_rect = {
-                            text_x, y,
-                            static_cast<float>(v.text_width),
-                            static_cast<float>(v.text_height)
-                        };
-
-                        Uint8 brightness = (vi == mi.selected_variant) ? 255 : 150;
-                        SDL_SetTextureColorMod(v.text_texture, brightness, brightness, brightness);
-                        SDL_RenderTexture(renderer, v.text_texture, NULL, &text_rect);
+                if (mi.variant_labels.empty()) {
+                    for (const auto &variant : apps[selected_app_index].variants) {
+                        mi.variant_labels.push_back(text_engine.create_text(variant.variant_name));
+                    }
+                }
+                for (int vi = 0; vi < mi.variant_labels.size(); ++vi) {
+                    TTF_Text* text = mi.variant_labels[vi];
+                    SDL_Point size = TextEngine::size(text);
+                    float text_x = (screen_w - size.x) / 2;
+                    float y = screen_h * 3 / 4 + (vi - mi.selected_variant) * FONT_SIZE * 3 / 2;
+
+                    Uint8 brightness = (vi == mi.selected_variant) ? 255 : 150;
+                    TextEngine::draw(text, text_x, y, brightness);
+                }
+            }
+
+            if (searching) {
+                if (!search_text) {
+                    search_text = text_engine.create_text("");
+                }
+                std::string line = "Search: " + query + " (" + std::to_string(shown.size()) + ")";
+                TTF_SetTextString(search_text, line.c_str(), line.length());
+                SDL_Point size = TextEngine::size(search_text);
+                TextEngine::draw(search_text, (screen_w - size.x) / 2, FONT_SIZE, 255);
+            }
+            if (osk_open) {
+                if (osk_texts.empty()) {
+                    for (char c : OSK_CHARS) {
+                        osk_texts.push_back(text_engine.create_text(c == ' ' ? "_" : std::string(1, c)));
                     }
                 }
+                const int cell = FONT_SIZE * 3 / 2;
+                const float osk_x = (screen_w - cell * int(osk_texts.size())) / 2;
+                const float osk_y = screen_h - cell * 2;
+                SDL_FRect cursor_rect = { osk_x + osk_cursor * cell, osk_y, float(cell), float(cell) };
+                SDL_SetRenderDrawColor(renderer, 60, 60, 90, 255);
+                SDL_RenderFillRect(renderer, &cursor_rect);
+                for (int c = 0; c < osk_texts.size(); ++c) {
+                    SDL_Point size = TextEngine::size(osk_texts[c]);
+                    TextEngine::draw(osk_texts[c], osk_x + c * cell + (cell - size.x) / 2, osk_y + (cell - size.y) / 2,
+                                     c == osk_cursor ? 255 : 150);
+                }
+            }
+            if (frame_stats.hud) {
+                frame_stats.draw_hud(renderer, hud_text);
+            }
+            if (render_target) {
+                SDL_SetRenderTarget(renderer, NULL);
+                SDL_RenderTexture(renderer, render_target.get(), NULL, NULL);
             }
 
+            const Uint64 present_start_ns = SDL_GetTicksNS();
+            t_phase = Profiler::now_ns();
             SDL_RenderPresent(renderer);
+            resident.frame++;
+            if (frame_stats.enabled) {
+                const Uint64 present_end_ns = SDL_GetTicksNS();
+                frame_stats.cpu_ms.add((present_start_ns - frame_start_ns) / 1e6);
+                frame_stats.present_ms.add((present_end_ns - present_start_ns) / 1e6);
+                if (pending_input_ns && pending_input_ns <= present_end_ns) {
+                    frame_stats.input_latency_ms.add((present_end_ns - pending_input_ns) / 1e6);
+                }
+            }
+            pending_input_ns = 0;
+            if (frames_rendered == 0) {
+                profiler.add("first SDL_RenderPresent", t_phase);
+                profiler.add(profiler.pass == 0 ? "boot to menu" : "return to menu", t_pass);
+                profiler.write();
+            }
+
+            Uint64 now_ns = SDL_GetTicksNS();
+            Uint64 idle_frames = (now_ns - last_present_ns) / frame_period_ns;
+            frames_skipped += idle_frames > 0 ? idle_frames - 1 : 0;
+            frames_rendered++;
+            last_present_ns = now_ns;
+
+            if (returned_at_ns) {
+                Uint64 elapsed_ns = SDL_GetTicksNS() - returned_at_ns;
+                std::cout << "Launcher: Back in menu after " << (elapsed_ns / 1000) / 1000.0 << " ms" << std::endl;
+                returned_at_ns = 0;
+                if (last_launch_offset >= 0) {
+                    history.set_menu_ms(last_launch_offset, last_launch, Uint32(elapsed_ns / 1000000));
+                    last_launch_offset = -1;
+                }
+            }
+        }
+
+        {
+            Uint64 idle_frames = (SDL_GetTicksNS() - last_present_ns) / frame_period_ns;
+            frames_skipped += idle_frames;
+            total_frames += frames_rendered;
+            std::cout << "Launcher: Frames rendered: " << frames_rendered
+                      << ", skipped: " << frames_skipped
+                      << ", static layer redrawn: " << static_layer_updates << std::endl;
+            size_t resident_items = std::count_if(resident.items.begin(), resident.items.end(),
+                                                  [](const ResidentAssets::Item &item) { return item.loaded; });
+            std::cout << "Launcher: " << resident_items << " of " << resident.items.size() << " items resident in "
+                      << resident.atlas.pages.size() << " atlas page(s), " << resident.evictions << " evictions" << std::endl;
+            textures.report(std::cout);
+            if (frame_stats.enabled) {
+                frame_stats.dump(std::cout);
+            }
         }
 
         // 6. Cleanup SDL resources *before* launching the external app
-        std::string command_to_run = "";
+        const App* app_to_run = nullptr;
+        const App::Variant* variant_to_run = nullptr;
         if (selected_app_index >= 0 && selected_app_index < apps.size()) {
             App &app = apps[selected_app_index];
             MenuItem &mi = menu_items[selected_app_index];
-            command_to_run = app.variants[mi.selected_variant].command;
+            if (mi.selected_variant < app.variants.size()) {
+                app_to_run = &app;
+                variant_to_run = &app.variants[mi.selected_variant];
+            }
         } else {
             loop = false;
         }
 
         // Close all open gamepads
+        t_phase = Profiler::now_ns();
         for (auto pad : gamepads) {
             SDL_CloseGamepad(pad);
         }
         gamepads.clear();
 
 
-        for (int i = 0; i < menu_items.size(); ++i) {
-            MenuItem &mi = menu_items[i];
-            SDL_DestroyTexture(mi.icon_texture);
-            SDL_DestroyTexture(mi.text_texture);
-            for (int vi = 0; vi < mi.variants.size(); ++vi) {
-                auto &v = mi.variants[vi];
-                SDL_DestroyTexture(v.text_texture);
-            }
-        }
+        free_menu_labels(menu_items);
         menu_items.clear();
-        TTF_CloseFont(font);
+        TTF_DestroyText(hud_text);
+        TTF_DestroyText(search_text);
+        for (TTF_Text* text : osk_texts) {
+            TTF_DestroyText(text);
+        }
+        text_engine.destroy_engine();
+        resident.atlas.release_textures();
+        // Don't compete with the launched app; unfinished items are asked
+        // for again when they are needed.
+        cancel_requests(resident, loader);
+        background.reset();
+        static_layer.reset();
+        render_target.reset();
+        textures.renderer = nullptr;
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
-        TTF_Quit();
-        SDL_Quit();
+        SDL_QuitSubSystem(SDL_INIT_VIDEO | SDL_INIT_GAMEPAD);
+        profiler.add("teardown", t_phase, "return");
 
+        t_phase = Profiler::now_ns();
         SDL_Delay(250); // Some time for the drm/kms stuff to flicker the screen. Might be totally unnecessary.
+        profiler.add("drm handoff delay", t_phase, "return");
 
         // 7. Launch the selected application
-        if (!command_to_run.empty()) {
-            std::cout << "Launcher: Cleaning up and executing '" << command_to_run << "'" << std::endl;
-            system(command_to_run.c_str());
+        if (variant_to_run && replay.active()) {
+            std::cout << "Replay: Not launching '" << variant_to_run->command << "'" << std::endl;
+        } else if (variant_to_run) {
+            std::cout << "Launcher: Cleaning up and executing '" << variant_to_run->command << "'" << std::endl;
+            t_phase = Profiler::now_ns();
+            Sint64 start_unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+            LaunchResult result = launch_variant(*app_to_run, *variant_to_run);
+            returned_at_ns = SDL_GetTicksNS();
+            last_launch = LaunchHistory::make_record(*app_to_run, *variant_to_run, start_unix_ms, result);
+            last_launch_offset = history.append(last_launch);
+            profiler.add("launch: " + variant_to_run->command, t_phase, "return");
         } else {
             std::cout << "Launcher: Exiting gracefully." << std::endl;
         }
+        profiler.pass++;
     }
+    profiler.write();
 
+    watcher.stop();
+    loader.stop();
+    free_resident_assets(resident);
+    text_engine.close();
+    TTF_Quit();
+    SDL_Quit();
+
+    if (replay.active()) {
+        return replay.report((SDL_GetTicksNS() - run_start_ns) / 1e6, total_frames);
+    }
     return 0;
 }